@@ -0,0 +1,28 @@
+//
+// assetrequest.cpp
+//
+
+#include "assetrequest.h"
+#include <chrono>
+#include <thread>
+
+using namespace std;
+using namespace DatumPlatform;
+
+
+///////////////////////// wait_asset ////////////////////////////////////////
+void const *wait_asset(PlatformInterface &platform, AssetManager &assets, Asset const *asset, float timeout)
+{
+  auto deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<float>(timeout));
+
+  while (true)
+  {
+    if (auto bits = assets.request(platform, asset))
+      return bits;
+
+    if (chrono::steady_clock::now() > deadline)
+      return nullptr;
+
+    this_thread::yield();
+  }
+}
@@ -0,0 +1,14 @@
+//
+// assetrequest.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/asset.h"
+
+// payload of an asset, requested until its read completes, the caller holds
+// the asset_guard. A read that never completes (a truncated or corrupt pack)
+// gives null once timeout seconds have passed
+
+void const *wait_asset(DatumPlatform::PlatformInterface &platform, AssetManager &assets, Asset const *asset, float timeout = 10.0f);
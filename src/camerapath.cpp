@@ -0,0 +1,79 @@
+//
+// camerapath.cpp
+//
+
+#include "camerapath.h"
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace lml;
+
+
+///////////////////////// load_camerapath ///////////////////////////////////
+void load_camerapath(const char *path, CameraPath &camerapath)
+{
+  ifstream fin(path);
+
+  if (!fin)
+    throw runtime_error(string("Camera Path Open Failure: ") + path);
+
+  camerapath.frames.clear();
+
+  string line;
+
+  while (getline(fin, line))
+  {
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    if (line.compare(0, 9, "settings ") == 0)
+    {
+      istringstream is(line.substr(9));
+
+      is >> camerapath.splitfar >> camerapath.viewheight;
+
+      if (!is)
+        throw runtime_error(string("Camera Path Parse Failure: ") + line);
+
+      continue;
+    }
+
+    CameraPath::Frame frame;
+
+    istringstream is(line);
+
+    is >> frame.position.x >> frame.position.y >> frame.position.z;
+    is >> frame.rotation.w >> frame.rotation.x >> frame.rotation.y >> frame.rotation.z;
+    is >> frame.sundirection.x >> frame.sundirection.y >> frame.sundirection.z;
+
+    if (!is)
+      throw runtime_error(string("Camera Path Parse Failure: ") + line);
+
+    camerapath.frames.push_back(frame);
+  }
+}
+
+
+///////////////////////// save_camerapath ///////////////////////////////////
+void save_camerapath(const char *path, CameraPath const &camerapath)
+{
+  ofstream fout(path, ios::trunc);
+
+  if (!fout)
+    throw runtime_error(string("Camera Path Open Failure: ") + path);
+
+  fout.precision(9);
+
+  fout << "# settings split far, view height\n";
+  fout << "settings " << camerapath.splitfar << ' ' << camerapath.viewheight << '\n';
+
+  fout << "# position, rotation (w x y z), sun direction\n";
+
+  for(auto &frame : camerapath.frames)
+  {
+    fout << frame.position.x << ' ' << frame.position.y << ' ' << frame.position.z << ' ';
+    fout << frame.rotation.w << ' ' << frame.rotation.x << ' ' << frame.rotation.y << ' ' << frame.rotation.z << ' ';
+    fout << frame.sundirection.x << ' ' << frame.sundirection.y << ' ' << frame.sundirection.z << '\n';
+  }
+}
@@ -0,0 +1,36 @@
+//
+// camerapath.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include <vector>
+
+//|---------------------- CameraPath ----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct CameraPath
+{
+  struct Frame
+  {
+    lml::Vec3 position;
+    lml::Quaternion3 rotation;
+    lml::Vec3 sundirection;
+  };
+
+  std::vector<Frame> frames;
+
+  // render settings the path was recorded with, culling depends on them
+
+  float splitfar = 25.0f;
+  int viewheight = 1080;
+};
+
+// text, a settings line : "settings" split far, view height, then one frame
+// per line : position (3) rotation (w x y z) sun direction (3)
+
+void load_camerapath(const char *path, CameraPath &camerapath);
+
+void save_camerapath(const char *path, CameraPath const &camerapath);
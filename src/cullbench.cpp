@@ -0,0 +1,236 @@
+//
+// Datum - culling benchmark
+//
+
+#include "toolplatform.h"
+#include "datumsponza.h"
+#include <leap.h>
+#include <leap/pathstring.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+using namespace lml;
+using namespace leap;
+using namespace DatumPlatform;
+
+//|---------------------- Benchmark -----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct Sample
+{
+  uint64_t ns;
+  size_t visible[GameState::ViewCount];
+  size_t occluded;
+};
+
+///////////////////////// default_path //////////////////////////////////////
+void default_path(CameraPath &camerapath)
+{
+  // down the nave and back along the upper gallery
+
+  const int frames = 600;
+
+  Vec3 sundirection = normalise(Vec3(0.5297f, -0.8123f, -0.2438f));
+
+  for(int i = 0; i < frames; ++i)
+  {
+    float t = (float)i / frames;
+
+    auto position = (t < 0.5f) ? Vec3(-12.0f + 48.0f * t, 1.8f, 0.0f) : Vec3(12.0f - 48.0f * (t - 0.5f), 6.5f, 3.5f);
+    auto target = position + Vec3(cos(6.0f * t), -0.1f, sin(6.0f * t));
+
+    camerapath.frames.push_back({ position, Transform::lookat(position, target, Vec3(0, 1, 0)).rotation(), sundirection });
+  }
+}
+
+///////////////////////// percentile ////////////////////////////////////////
+uint64_t percentile(vector<uint64_t> const &sorted, double p)
+{
+  return sorted[min((size_t)(p * sorted.size()), sorted.size() - 1)];
+}
+
+
+///////////////////////// main //////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  cout << "Cull Benchmark" << endl;
+
+  try
+  {
+    const char *pathfile = nullptr;
+    const char *csvfile = nullptr;
+
+    int passes = 5;
+    float splitfar = 0.0f;
+    bool occlusionculling = true;
+    bool parallel = true;
+
+    for(int i = 1; i < argc; ++i)
+    {
+      if (strcmp(argv[i], "-passes") == 0 && i + 1 < argc)
+        passes = max(atoi(argv[++i]), 1);
+
+      else if (strcmp(argv[i], "-splitfar") == 0 && i + 1 < argc)
+        splitfar = (float)atof(argv[++i]);
+
+      else if (strcmp(argv[i], "-csv") == 0 && i + 1 < argc)
+        csvfile = argv[++i];
+
+      else if (strcmp(argv[i], "-noocclusion") == 0)
+        occlusionculling = false;
+
+      else if (strcmp(argv[i], "-serial") == 0)
+        parallel = false;
+
+      else if (argv[i][0] != '-')
+        pathfile = argv[i];
+
+      else
+        throw runtime_error(string("usage: cullbench [camerapath.txt] [-passes n] [-splitfar z] [-noocclusion] [-serial] [-csv file]"));
+    }
+
+    ToolPlatform platform;
+
+    initialise_platform(platform, 256*1024*1024);
+
+    // the game state and scene as the game loads them, culled by the game's
+    // own cullscene with its default settings
+
+    GameState &state = *new(allocate<GameState>(platform.gamememory)) GameState(platform.gamememory);
+
+    initialise_asset_system(platform, state.assets, 64*1024, 128*1024*1024);
+
+    state.scene.initialise_component_storage<NameComponent>();
+    state.scene.initialise_component_storage<TransformComponent>();
+    state.scene.initialise_component_storage<SpriteComponent>();
+    state.scene.initialise_component_storage<MeshComponent>();
+    state.scene.initialise_component_storage<PointLightComponent>();
+    state.scene.initialise_component_storage<ParticleSystemComponent>();
+
+    load_scene(platform, state);
+
+    update_meshes(state.scene);
+
+    prepare_visibility(state.visibility, state.scene);
+
+    CameraPath camerapath;
+
+    if (pathfile)
+      load_camerapath(pathfile, camerapath);
+    else
+      default_path(camerapath);
+
+    if (camerapath.frames.empty())
+      throw runtime_error("Empty Camera Path");
+
+    // the split and view height the path was recorded with
+
+    state.rendercontext.shadows.shadowsplitfar = (splitfar > 0.0f) ? splitfar : camerapath.splitfar;
+    state.viewheight = camerapath.viewheight;
+    state.occlusionculling = occlusionculling;
+
+    Snapshot frame;
+    frame.camera.set_projection(state.fov*pi<float>()/180.0f, state.aspect, 0.1f, 2000.0f);
+
+    capture_dynamic(state.scene, frame.dynamicitems);
+
+    state.frame = &frame;
+
+    vector<Sample> samples;
+
+    // first pass warms the tree, caches and coherence and is not timed
+
+    for(int pass = 0; pass <= passes; ++pass)
+    {
+      for(auto &pathframe : camerapath.frames)
+      {
+        frame.camera.set_position(pathframe.position);
+        frame.camera.set_rotation(pathframe.rotation);
+        frame.sundirection = pathframe.sundirection;
+
+        auto start = chrono::steady_clock::now();
+
+        cullscene(platform, state, parallel);
+
+        auto end = chrono::steady_clock::now();
+
+        if (pass != 0)
+        {
+          Sample sample = { (uint64_t)chrono::duration_cast<chrono::nanoseconds>(end - start).count(), {}, state.visibility.occludeditems };
+
+          for(auto &visible : state.visibility.visible)
+          {
+            for(int view = 0; view < GameState::ViewCount; ++view)
+            {
+              if (visible.views & (1 << view))
+                sample.visible[view] += 1;
+            }
+          }
+
+          // static casters held by the shadow cache are drawn without being
+          // culled again
+
+          for(auto mask : state.shadowcache.drawmasks)
+          {
+            sample.visible[GameState::SunView] += (mask != 0);
+          }
+
+          samples.push_back(sample);
+        }
+      }
+    }
+
+    if (csvfile)
+    {
+      ofstream fout(csvfile, ios::trunc);
+
+      fout << "frame,ns,camera,sun,occluded\n";
+
+      for(size_t i = 0; i < samples.size(); ++i)
+      {
+        fout << i % camerapath.frames.size() << ',' << samples[i].ns << ',' << samples[i].visible[GameState::CameraView] << ',' << samples[i].visible[GameState::SunView] << ',' << samples[i].occluded << '\n';
+      }
+    }
+
+    vector<uint64_t> times;
+
+    uint64_t total = 0;
+    size_t visible[GameState::ViewCount] = {};
+    size_t occluded = 0;
+
+    for(auto &sample : samples)
+    {
+      times.push_back(sample.ns);
+
+      total += sample.ns;
+
+      for(int view = 0; view < GameState::ViewCount; ++view)
+        visible[view] += sample.visible[view];
+
+      occluded += sample.occluded;
+    }
+
+    sort(times.begin(), times.end());
+
+    cout << "  Items: " << state.visibility.items.size() << " static, " << state.visibility.dynamicitems.size() << " dynamic" << endl;
+    cout << "  Frames: " << camerapath.frames.size() << " x " << passes << (occlusionculling ? " (occlusion)" : "") << (parallel ? " (parallel)" : "") << ", split " << state.rendercontext.shadows.shadowsplitfar << endl;
+    cout << "  Mean: " << total / samples.size() << " ns" << endl;
+    cout << "  P50: " << percentile(times, 0.50) << " ns" << endl;
+    cout << "  P95: " << percentile(times, 0.95) << " ns" << endl;
+    cout << "  P99: " << percentile(times, 0.99) << " ns" << endl;
+    cout << "  Max: " << times.back() << " ns" << endl;
+    cout << "  Visible: " << visible[GameState::CameraView] / samples.size() << " camera, " << visible[GameState::SunView] / samples.size() << " sun" << endl;
+    cout << "  Occluded: " << occluded / samples.size() << " items" << endl;
+  }
+  catch(exception &e)
+  {
+    cerr << "Critical Error:" << e.what() << endl;
+
+    return 1;
+  }
+}
@@ -0,0 +1,327 @@
+//
+// cullkernel.cpp
+//
+
+#include "cullkernel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CULL_X86 1
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CULL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CULL_TARGET_AVX2
+#endif
+
+using namespace std;
+using namespace lml;
+
+namespace
+{
+  typedef float (*cull_func)(CullPlanes const &, CullBounds const &, size_t, size_t, uint32_t, uint32_t *);
+
+  // Each bound is classified by the least of its plane values (d + r); the
+  // bound is visible when it is non negative, and its magnitude is how far
+  // the planes can move before the classification can change. The kernels
+  // return the least such margin over the batch.
+
+  ///////////////////////// cull_scalar ///////////////////////////////////////
+  float cull_scalar(CullPlanes const &planes, CullBounds const &bounds, size_t first, size_t count, uint32_t bit, uint32_t *masks)
+  {
+    float margin = std::numeric_limits<float>::max();
+
+    for(size_t i = first, end = first + count; i != end; ++i)
+    {
+      float lo = std::numeric_limits<float>::max();
+
+      for(int k = 0; k < planes.count; ++k)
+      {
+        float d = planes.nx[k] * bounds.cx[i] + planes.ny[k] * bounds.cy[i] + planes.nz[k] * bounds.cz[i] + planes.d[k];
+        float r = planes.ax[k] * bounds.ex[i] + planes.ay[k] * bounds.ey[i] + planes.az[k] * bounds.ez[i];
+
+        lo = std::min(lo, d + r);
+      }
+
+      if (lo >= 0.0f)
+        masks[i] |= bit;
+
+      margin = std::min(margin, std::abs(lo));
+    }
+
+    return margin;
+  }
+
+#if CULL_X86
+
+  ///////////////////////// cull_sse //////////////////////////////////////////
+  float cull_sse(CullPlanes const &planes, CullBounds const &bounds, size_t first, size_t count, uint32_t bit, uint32_t *masks)
+  {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 large = _mm_set1_ps(std::numeric_limits<float>::max());
+    const __m128i bitv = _mm_set1_epi32(bit);
+
+    __m128 margin = large;
+
+    size_t i = first, end = first + count;
+
+    for(; i + 4 <= end; i += 4)
+    {
+      __m128 cx = _mm_loadu_ps(bounds.cx.data() + i);
+      __m128 cy = _mm_loadu_ps(bounds.cy.data() + i);
+      __m128 cz = _mm_loadu_ps(bounds.cz.data() + i);
+      __m128 ex = _mm_loadu_ps(bounds.ex.data() + i);
+      __m128 ey = _mm_loadu_ps(bounds.ey.data() + i);
+      __m128 ez = _mm_loadu_ps(bounds.ez.data() + i);
+
+      __m128 lo = large;
+
+      for(int k = 0; k < planes.count; ++k)
+      {
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nx[k]), cx), _mm_mul_ps(_mm_set1_ps(planes.ny[k]), cy)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nz[k]), cz), _mm_set1_ps(planes.d[k])));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.ax[k]), ex), _mm_mul_ps(_mm_set1_ps(planes.ay[k]), ey)), _mm_mul_ps(_mm_set1_ps(planes.az[k]), ez));
+
+        lo = _mm_min_ps(lo, _mm_add_ps(d, r));
+      }
+
+      __m128i m = _mm_loadu_si128((__m128i const *)(masks + i));
+
+      m = _mm_or_si128(m, _mm_and_si128(_mm_castps_si128(_mm_cmpge_ps(lo, zero)), bitv));
+
+      _mm_storeu_si128((__m128i *)(masks + i), m);
+
+      margin = _mm_min_ps(margin, _mm_andnot_ps(sign, lo));
+    }
+
+    margin = _mm_min_ps(margin, _mm_shuffle_ps(margin, margin, _MM_SHUFFLE(2, 3, 0, 1)));
+    margin = _mm_min_ps(margin, _mm_shuffle_ps(margin, margin, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    return std::min(_mm_cvtss_f32(margin), cull_scalar(planes, bounds, i, end - i, bit, masks));
+  }
+
+  ///////////////////////// cull_avx2 /////////////////////////////////////////
+  CULL_TARGET_AVX2 float cull_avx2(CullPlanes const &planes, CullBounds const &bounds, size_t first, size_t count, uint32_t bit, uint32_t *masks)
+  {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 large = _mm256_set1_ps(std::numeric_limits<float>::max());
+    const __m256i bitv = _mm256_set1_epi32(bit);
+
+    __m256 margin = large;
+
+    size_t i = first, end = first + count;
+
+    for(; i + 8 <= end; i += 8)
+    {
+      __m256 cx = _mm256_loadu_ps(bounds.cx.data() + i);
+      __m256 cy = _mm256_loadu_ps(bounds.cy.data() + i);
+      __m256 cz = _mm256_loadu_ps(bounds.cz.data() + i);
+      __m256 ex = _mm256_loadu_ps(bounds.ex.data() + i);
+      __m256 ey = _mm256_loadu_ps(bounds.ey.data() + i);
+      __m256 ez = _mm256_loadu_ps(bounds.ez.data() + i);
+
+      __m256 lo = large;
+
+      for(int k = 0; k < planes.count; ++k)
+      {
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.nx[k]), cx), _mm256_mul_ps(_mm256_set1_ps(planes.ny[k]), cy)), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.nz[k]), cz), _mm256_set1_ps(planes.d[k])));
+        __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.ax[k]), ex), _mm256_mul_ps(_mm256_set1_ps(planes.ay[k]), ey)), _mm256_mul_ps(_mm256_set1_ps(planes.az[k]), ez));
+
+        lo = _mm256_min_ps(lo, _mm256_add_ps(d, r));
+      }
+
+      __m256i m = _mm256_loadu_si256((__m256i const *)(masks + i));
+
+      m = _mm256_or_si256(m, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(lo, zero, _CMP_GE_OQ)), bitv));
+
+      _mm256_storeu_si256((__m256i *)(masks + i), m);
+
+      margin = _mm256_min_ps(margin, _mm256_andnot_ps(sign, lo));
+    }
+
+    __m128 half = _mm_min_ps(_mm256_castps256_ps128(margin), _mm256_extractf128_ps(margin, 1));
+
+    half = _mm_min_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(2, 3, 0, 1)));
+    half = _mm_min_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    return std::min(_mm_cvtss_f32(half), cull_sse(planes, bounds, i, end - i, bit, masks));
+  }
+
+  ///////////////////////// has_avx2 //////////////////////////////////////////
+  bool has_avx2()
+  {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+
+    if (info[0] < 7)
+      return false;
+
+    __cpuid(info, 1);
+
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+      return false;
+
+    if ((_xgetbv(0) & 6) != 6)
+      return false;
+
+    __cpuidex(info, 7, 0);
+
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx2");
+#endif
+  }
+
+#endif
+
+  ///////////////////////// select_kernel /////////////////////////////////////
+  cull_func select_kernel(const char **name)
+  {
+#if CULL_X86
+    if (has_avx2())
+    {
+      *name = "avx2";
+      return cull_avx2;
+    }
+
+    *name = "sse";
+    return cull_sse;
+#else
+    *name = "scalar";
+    return cull_scalar;
+#endif
+  }
+
+  const char *kernelname = nullptr;
+  const cull_func kernel = select_kernel(&kernelname);
+}
+
+
+//|---------------------- CullPlanes ----------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// cull_planes ///////////////////////////////////////
+CullPlanes cull_planes(Frustum const &frustum)
+{
+  // The frustum planes are turned to face the centre (whatever the sign
+  // convention) and their distances refit to the corners, so the result
+  // stays conservative and keeps the frustum's plane order.
+
+  Vec3 centre = Vec3(0.0f, 0.0f, 0.0f);
+
+  for(int i = 0; i < 8; ++i)
+    centre += frustum.corners[i] / 8.0f;
+
+  CullPlanes planes;
+
+  planes.count = 6;
+
+  for(int p = 0; p < 6; ++p)
+  {
+    auto normal = normalise(frustum.planes[p].normal);
+
+    if (dot(frustum.planes[p].normal, centre) + frustum.planes[p].distance < 0.0f)
+      normal = -normal;
+
+    float distance = std::numeric_limits<float>::max();
+
+    for(int i = 0; i < 8; ++i)
+      distance = std::min(distance, dot(normal, frustum.corners[i]));
+
+    planes.nx[p] = normal.x;
+    planes.ny[p] = normal.y;
+    planes.nz[p] = normal.z;
+    planes.d[p] = -distance;
+  }
+
+  for(int p = 0; p < 6; ++p)
+  {
+    planes.ax[p] = std::abs(planes.nx[p]);
+    planes.ay[p] = std::abs(planes.ny[p]);
+    planes.az[p] = std::abs(planes.nz[p]);
+  }
+
+  return planes;
+}
+
+
+///////////////////////// cull_planes ///////////////////////////////////////
+CullPlanes cull_planes(CullPlanes const &planes, uint32_t planemask)
+{
+  CullPlanes result;
+
+  result.count = 0;
+
+  for(int p = 0; p < planes.count; ++p)
+  {
+    if (planemask & (1 << p))
+    {
+      result.nx[result.count] = planes.nx[p];
+      result.ny[result.count] = planes.ny[p];
+      result.nz[result.count] = planes.nz[p];
+      result.d[result.count] = planes.d[p];
+      result.ax[result.count] = planes.ax[p];
+      result.ay[result.count] = planes.ay[p];
+      result.az[result.count] = planes.az[p];
+      result.count += 1;
+    }
+  }
+
+  return result;
+}
+
+
+//|---------------------- CullBounds ----------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// CullBounds::clear /////////////////////////////////
+void CullBounds::clear()
+{
+  cx.clear();
+  cy.clear();
+  cz.clear();
+  ex.clear();
+  ey.clear();
+  ez.clear();
+}
+
+
+///////////////////////// CullBounds::push_back /////////////////////////////
+void CullBounds::push_back(Bound3 const &bound)
+{
+  cx.push_back(0.5f * (bound.min.x + bound.max.x));
+  cy.push_back(0.5f * (bound.min.y + bound.max.y));
+  cz.push_back(0.5f * (bound.min.z + bound.max.z));
+  ex.push_back(0.5f * (bound.max.x - bound.min.x));
+  ey.push_back(0.5f * (bound.max.y - bound.min.y));
+  ez.push_back(0.5f * (bound.max.z - bound.min.z));
+}
+
+
+//|---------------------- Cull Kernel ---------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// cull_bounds ///////////////////////////////////////
+float cull_bounds(CullPlanes const &planes, CullBounds const &bounds, size_t first, size_t count, uint32_t bit, uint32_t *masks)
+{
+  return kernel(planes, bounds, first, count, bit, masks);
+}
+
+
+///////////////////////// cull_kernel_name //////////////////////////////////
+const char *cull_kernel_name()
+{
+  return kernelname;
+}
@@ -0,0 +1,59 @@
+//
+// cullkernel.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include <vector>
+
+//|---------------------- CullPlanes ----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct CullPlanes
+{
+  int count;
+
+  // plane equations, inside is nx*x + ny*y + nz*z + d >= 0
+
+  float nx[6], ny[6], nz[6], d[6];
+
+  // absolute normals, for the box extent term
+
+  float ax[6], ay[6], az[6];
+};
+
+CullPlanes cull_planes(lml::Frustum const &frustum);
+
+// subset of planes selected by bit mask
+
+CullPlanes cull_planes(CullPlanes const &planes, uint32_t planemask);
+
+
+//|---------------------- CullBounds ----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct CullBounds
+{
+  // centre/extent form, structure of arrays
+
+  std::vector<float> cx, cy, cz;
+  std::vector<float> ex, ey, ez;
+
+  size_t size() const { return cx.size(); }
+
+  void clear();
+  void push_back(lml::Bound3 const &bound);
+};
+
+
+//|---------------------- Cull Kernel ---------------------------------------
+//|--------------------------------------------------------------------------
+
+// sets bit in masks[i] for every bound [first, first + count) that intersects
+// the planes, returns how far the planes can move before any result changes
+
+float cull_bounds(CullPlanes const &planes, CullBounds const &bounds, size_t first, size_t count, uint32_t bit, uint32_t *masks);
+
+const char *cull_kernel_name();
@@ -3,6 +3,8 @@
 //
 
 #include "platform.h"
+#include "frametimes.h"
+#include "lateinput.h"
 #include <leap.h>
 #include <leap/pathstring.h>
 #include <windows.h>
@@ -23,13 +25,13 @@ void datumsponza_render(DatumPlatform::PlatformInterface &platform, DatumPlatfor
 //|---------------------- Platform ------------------------------------------
 //|--------------------------------------------------------------------------
 
-class Platform : public PlatformInterface
+class Platform : public PlatformInterface, public LateInputPlatform
 {
   public:
 
     Platform();
 
-    void initialise(RenderDevice const &renderdevice, size_t gamememorysize, size_t scratchmemorysize);
+    void initialise(RenderDevice const &renderdevice, InputBuffer const *inputbuffer, size_t gamememorysize, size_t scratchmemorysize);
 
   public:
 
@@ -55,6 +57,10 @@ class Platform : public PlatformInterface
 
     void submit_work(void (*func)(PlatformInterface &, void*, void*), void *ldata, void *rdata) override;
 
+    // input, mouse movement the next update has not taken, for late latching
+
+    void sample_late_input(LateInput &input) override;
+
     // misc
 
     void terminate() override;
@@ -69,6 +75,8 @@ class Platform : public PlatformInterface
 
     RenderDevice m_renderdevice;
 
+    InputBuffer const *m_inputbuffer;
+
     WorkQueue m_workqueue;
 };
 
@@ -77,13 +85,16 @@ class Platform : public PlatformInterface
 Platform::Platform()
 {
   m_terminaterequested = false;
+
+  m_inputbuffer = nullptr;
 }
 
 
 ///////////////////////// Platform::initialise //////////////////////////////
-void Platform::initialise(RenderDevice const &renderdevice, size_t gamememorysize, size_t scratchmemorysize)
+void Platform::initialise(RenderDevice const &renderdevice, InputBuffer const *inputbuffer, size_t gamememorysize, size_t scratchmemorysize)
 {
   m_renderdevice = renderdevice;
+  m_inputbuffer = inputbuffer;
 
   gamememory_initialise(gamememory, new char[gamememorysize], gamememorysize);
   gamememory_initialise(gamescratchmemory, new char[scratchmemorysize], scratchmemorysize);
@@ -161,6 +172,13 @@ void Platform::submit_work(void (*func)(PlatformInterface &, void*, void*), void
 }
 
 
+///////////////////////// Platform::sample_late_input ///////////////////////
+void Platform::sample_late_input(LateInput &input)
+{
+  m_inputbuffer->peek_mouse(&input.deltamousex, &input.deltamousey, &input.leftbutton);
+}
+
+
 ///////////////////////// Platform::terminate ///////////////////////////////
 void Platform::terminate()
 {
@@ -185,6 +203,8 @@ class Game
 
     void render(VkImage image, VkSemaphore acquirecomplete, VkSemaphore rendercomplete, int x, int y, int width, int height);
 
+    void presented();
+
     void terminate();
 
   public:
@@ -210,6 +230,15 @@ class Game
 
     int m_fpscount;
     chrono::high_resolution_clock::time_point m_fpstimer;
+
+    // oldest input consumed by the updates since the last render, and the
+    // one the render in flight used, updates and renders share the thread
+
+    bool m_inputpending;
+    InputBuffer::clock::time_point m_pendinginput;
+
+    bool m_inputrendered;
+    InputBuffer::clock::time_point m_renderedinput;
 };
 
 
@@ -220,6 +249,9 @@ Game::Game()
 
   m_fpscount = 0;
   m_fpstimer = std::chrono::high_resolution_clock::now();
+
+  m_inputpending = false;
+  m_inputrendered = false;
 }
 
 
@@ -240,7 +272,7 @@ void Game::init(VkPhysicalDevice physicaldevice, VkDevice device, VkQueue render
   renderdevice.queues[0] = { renderqueue, renderqueuefamily };
   renderdevice.queues[1] = { transferqueue, transferqueuefamily };
 
-  m_platform.initialise(renderdevice, 256*1024*1024, 16*1024*1024);
+  m_platform.initialise(renderdevice, &m_inputbuffer, 256*1024*1024, 16*1024*1024);
 
   game_init(m_platform);
 
@@ -261,12 +293,26 @@ void Game::resize(int x, int y, int width, int height)
 ///////////////////////// Game::update //////////////////////////////////////
 void Game::update(float dt)
 {
-  GameInput input = m_inputbuffer.grab();
+  InputBuffer::Stamp stamp;
+
+  GameInput input = m_inputbuffer.grab(&stamp);
 
   m_platform.gamescratchmemory.size = 0;
 
+  auto start = std::chrono::steady_clock::now();
+
   game_update(m_platform, input, dt);
 
+  record_frametime(frame_times(), FrameTimes::Update, std::chrono::duration<float, milli>(std::chrono::steady_clock::now() - start).count());
+
+  if (stamp.events != 0)
+  {
+    if (!m_inputpending || stamp.oldest < m_pendinginput)
+      m_pendinginput = stamp.oldest;
+
+    m_inputpending = true;
+  }
+
   if (m_platform.terminate_requested())
     terminate();
 }
@@ -277,8 +323,25 @@ void Game::render(VkImage image, VkSemaphore acquirecomplete, VkSemaphore render
 {
   m_platform.renderscratchmemory.size = 0;
 
+  auto start = std::chrono::steady_clock::now();
+
+  m_inputrendered = m_inputpending;
+  m_renderedinput = m_pendinginput;
+
+  m_inputpending = false;
+
   game_render(m_platform, { x, y, width, height, image, acquirecomplete, rendercomplete });
 
+  auto submitted = std::chrono::steady_clock::now();
+
+  record_frametime(frame_times(), FrameTimes::Render, std::chrono::duration<float, milli>(submitted - start).count());
+
+  if (m_inputrendered)
+  {
+    record_frametime(frame_times(), FrameTimes::InputToFrame, std::chrono::duration<float, milli>(start - m_renderedinput).count());
+    record_frametime(frame_times(), FrameTimes::InputToSubmit, std::chrono::duration<float, milli>(submitted - m_renderedinput).count());
+  }
+
   ++m_fpscount;
 
   auto tick = std::chrono::high_resolution_clock::now();
@@ -293,6 +356,18 @@ void Game::render(VkImage image, VkSemaphore acquirecomplete, VkSemaphore render
 }
 
 
+///////////////////////// Game::presented ///////////////////////////////////
+void Game::presented()
+{
+  if (m_inputrendered)
+  {
+    record_frametime(frame_times(), FrameTimes::InputToPresent, std::chrono::duration<float, milli>(std::chrono::steady_clock::now() - m_renderedinput).count());
+
+    m_inputrendered = false;
+  }
+}
+
+
 ///////////////////////// Game::terminate ///////////////////////////////////
 void Game::terminate()
 {
@@ -998,9 +1073,21 @@ void Window::paint(UINT msg, WPARAM wParam, LPARAM lParam)
 {
   if (window.visible && !window.resizing)
   {
+    auto acquirestart = std::chrono::steady_clock::now();
+
     vulkan.acquire();
+
+    record_frametime(frame_times(), FrameTimes::Acquire, std::chrono::duration<float, milli>(std::chrono::steady_clock::now() - acquirestart).count());
+
     window.game->render(vulkan.presentimages[vulkan.imageindex], vulkan.acquirecomplete[vulkan.frame & 1], vulkan.rendercomplete[vulkan.frame & 1], 0, 0, window.width, window.height);
+
+    auto presentstart = std::chrono::steady_clock::now();
+
     vulkan.present();
+
+    window.game->presented();
+
+    record_frametime(frame_times(), FrameTimes::Present, std::chrono::duration<float, milli>(std::chrono::steady_clock::now() - presentstart).count());
   }
 }
 
@@ -1197,6 +1284,8 @@ int main(int argc, char *args[])
       }
     }
 
+    write_frametimes(frame_times(), "frametimes.json");
+
     vulkan.destroy();
   }
   catch(exception &e)
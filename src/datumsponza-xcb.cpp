@@ -3,11 +3,16 @@
 //
 
 #include "platform.h"
+#include "frametimes.h"
+#include "lateinput.h"
 #include <leap.h>
 #include <leap/pathstring.h>
 #include <vulkan/vulkan.h>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <poll.h>
+#include <sys/resource.h>
 
 using namespace std;
 using namespace leap;
@@ -21,13 +26,13 @@ void datumsponza_render(DatumPlatform::PlatformInterface &platform, DatumPlatfor
 //|---------------------- Platform ------------------------------------------
 //|--------------------------------------------------------------------------
 
-class Platform : public PlatformInterface
+class Platform : public PlatformInterface, public LateInputPlatform
 {
   public:
 
     Platform();
 
-    void initialise(RenderDevice const &renderdevice, size_t gamememorysize, size_t scratchmemorysize);
+    void initialise(RenderDevice const &renderdevice, InputBuffer const *inputbuffer, size_t gamememorysize, size_t scratchmemorysize);
 
   public:
 
@@ -53,6 +58,10 @@ class Platform : public PlatformInterface
 
     void submit_work(void (*func)(PlatformInterface &, void*, void*), void *ldata, void *rdata) override;
 
+    // input, mouse movement the next update has not taken, for late latching
+
+    void sample_late_input(LateInput &input) override;
+
     // misc
 
     void terminate() override;
@@ -67,6 +76,8 @@ class Platform : public PlatformInterface
 
     RenderDevice m_renderdevice;
 
+    InputBuffer const *m_inputbuffer;
+
     WorkQueue m_workqueue;
 };
 
@@ -75,13 +86,16 @@ class Platform : public PlatformInterface
 Platform::Platform()
 {
   m_terminaterequested = false;
+
+  m_inputbuffer = nullptr;
 }
 
 
 ///////////////////////// Platform::initialise //////////////////////////////
-void Platform::initialise(RenderDevice const &renderdevice, size_t gamememorysize, size_t scratchmemorysize)
+void Platform::initialise(RenderDevice const &renderdevice, InputBuffer const *inputbuffer, size_t gamememorysize, size_t scratchmemorysize)
 {
   m_renderdevice = renderdevice;
+  m_inputbuffer = inputbuffer;
 
   gamememory_initialise(gamememory, new char[gamememorysize], gamememorysize);
   gamememory_initialise(gamescratchmemory, new char[scratchmemorysize], scratchmemorysize);
@@ -159,6 +173,13 @@ void Platform::submit_work(void (*func)(PlatformInterface &, void*, void*), void
 }
 
 
+///////////////////////// Platform::sample_late_input ///////////////////////
+void Platform::sample_late_input(LateInput &input)
+{
+  m_inputbuffer->peek_mouse(&input.deltamousex, &input.deltamousey, &input.leftbutton);
+}
+
+
 ///////////////////////// Platform::terminate ///////////////////////////////
 void Platform::terminate()
 {
@@ -183,6 +204,8 @@ class Game
 
     void render(VkImage image, VkSemaphore acquirecomplete, VkSemaphore rendercomplete, int x, int y, int width, int height);
 
+    void presented();
+
     void terminate();
 
   public:
@@ -208,6 +231,16 @@ class Game
 
     int m_fpscount;
     chrono::high_resolution_clock::time_point m_fpstimer;
+
+    // oldest input consumed by the updates since the last render, and the
+    // one the render in flight used
+
+    mutex m_inputlock;
+    bool m_inputpending;
+    InputBuffer::clock::time_point m_pendinginput;
+
+    bool m_inputrendered;
+    InputBuffer::clock::time_point m_renderedinput;
 };
 
 
@@ -218,6 +251,9 @@ Game::Game()
 
   m_fpscount = 0;
   m_fpstimer = std::chrono::high_resolution_clock::now();
+
+  m_inputpending = false;
+  m_inputrendered = false;
 }
 
 
@@ -238,7 +274,7 @@ void Game::init(VkPhysicalDevice physicaldevice, VkDevice device, VkQueue render
   renderdevice.queues[0] = { renderqueue, renderqueuefamily };
   renderdevice.queues[1] = { transferqueue, transferqueuefamily };
 
-  m_platform.initialise(renderdevice, 256*1024*1024, 16*1024*1024);
+  m_platform.initialise(renderdevice, &m_inputbuffer, 256*1024*1024, 16*1024*1024);
 
   game_init(m_platform);
 
@@ -259,12 +295,28 @@ void Game::resize(int x, int y, int width, int height)
 ///////////////////////// Game::update //////////////////////////////////////
 void Game::update(float dt)
 {
-  GameInput input = m_inputbuffer.grab();
+  InputBuffer::Stamp stamp;
+
+  GameInput input = m_inputbuffer.grab(&stamp);
 
   m_platform.gamescratchmemory.size = 0;
 
+  auto start = std::chrono::steady_clock::now();
+
   game_update(m_platform, input, dt);
 
+  record_frametime(frame_times(), FrameTimes::Update, std::chrono::duration<float, milli>(std::chrono::steady_clock::now() - start).count());
+
+  if (stamp.events != 0)
+  {
+    lock_guard<mutex> lock(m_inputlock);
+
+    if (!m_inputpending || stamp.oldest < m_pendinginput)
+      m_pendinginput = stamp.oldest;
+
+    m_inputpending = true;
+  }
+
   if (m_platform.terminate_requested())
     terminate();
 }
@@ -275,8 +327,29 @@ void Game::render(VkImage image, VkSemaphore acquirecomplete, VkSemaphore render
 {
   m_platform.renderscratchmemory.size = 0;
 
+  auto start = std::chrono::steady_clock::now();
+
+  {
+    lock_guard<mutex> lock(m_inputlock);
+
+    m_inputrendered = m_inputpending;
+    m_renderedinput = m_pendinginput;
+
+    m_inputpending = false;
+  }
+
   game_render(m_platform, { x, y, width, height, image, acquirecomplete, rendercomplete });
 
+  auto submitted = std::chrono::steady_clock::now();
+
+  record_frametime(frame_times(), FrameTimes::Render, std::chrono::duration<float, milli>(submitted - start).count());
+
+  if (m_inputrendered)
+  {
+    record_frametime(frame_times(), FrameTimes::InputToFrame, std::chrono::duration<float, milli>(start - m_renderedinput).count());
+    record_frametime(frame_times(), FrameTimes::InputToSubmit, std::chrono::duration<float, milli>(submitted - m_renderedinput).count());
+  }
+
   ++m_fpscount;
 
   auto tick = std::chrono::high_resolution_clock::now();
@@ -291,6 +364,18 @@ void Game::render(VkImage image, VkSemaphore acquirecomplete, VkSemaphore render
 }
 
 
+///////////////////////// Game::presented ///////////////////////////////////
+void Game::presented()
+{
+  if (m_inputrendered)
+  {
+    record_frametime(frame_times(), FrameTimes::InputToPresent, std::chrono::duration<float, milli>(std::chrono::steady_clock::now() - m_renderedinput).count());
+
+    m_inputrendered = false;
+  }
+}
+
+
 ///////////////////////// Game::terminate ///////////////////////////////////
 void Game::terminate()
 {
@@ -1079,10 +1164,64 @@ void Window::show()
 //|---------------------- main ----------------------------------------------
 //|--------------------------------------------------------------------------
 
+///////////////////////// cpu_seconds ///////////////////////////////////////
+double cpu_seconds()
+{
+  rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+
+///////////////////////// wait_for_events ///////////////////////////////////
+void wait_for_events(xcb_connection_t *connection, FramePacer::clock::duration timeout)
+{
+  auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+
+  timespec ts = { (time_t)(nanoseconds / 1000000000), (long)(nanoseconds % 1000000000) };
+
+  pollfd fd = { xcb_get_file_descriptor(connection), POLLIN, 0 };
+
+  ppoll(&fd, 1, &ts, nullptr);
+}
+
+
 int main(int argc, char *args[])
 {
   cout << "Datum Sponza" << endl;
 
+  // -pipelined runs the updates on their own thread, alongside the render,
+  // -hz sets the update rate, -maxticks the catch up cap after a stall and
+  // -fps the frame rate frames are reported late against, -blocking sleeps
+  // on the connection between frames instead of spinning, paced at -fps
+
+  bool pipelined = false;
+  bool blocking = false;
+
+  int hz = 60;
+  int maxticks = 4;
+  int targetfps = 60;
+
+  for(int i = 1; i < argc; ++i)
+  {
+    if (strcmp(args[i], "-pipelined") == 0)
+      pipelined = true;
+
+    if (strcmp(args[i], "-blocking") == 0)
+      blocking = true;
+
+    if (strcmp(args[i], "-hz") == 0 && i + 1 < argc)
+      hz = std::max(atoi(args[++i]), 1);
+
+    if (strcmp(args[i], "-maxticks") == 0 && i + 1 < argc)
+      maxticks = std::max(atoi(args[++i]), 1);
+
+    if (strcmp(args[i], "-fps") == 0 && i + 1 < argc)
+      targetfps = std::max(atoi(args[++i]), 1);
+  }
+
   try
   {
     Game game;
@@ -1097,34 +1236,139 @@ int main(int argc, char *args[])
 
     window.show();
 
-    int hz = 60;
+    FramePacer pacer(hz, maxticks, targetfps);
 
-    auto dt = std::chrono::nanoseconds(std::chrono::seconds(1)) / hz;
+    // pipelined, update for the next tick runs while the render submits and
+    // presents the last one, they meet at the game's snapshot buffer
+    // (published at the end of each update, taken at the start of each
+    // render) and the game's scene lock (held by render up to its submit)
 
-    auto tick = std::chrono::high_resolution_clock::now();
+    thread updater;
 
-    while (game.running())
+    if (pipelined)
     {
-      if (xcb_generic_event_t *event = xcb_poll_for_event(window.connection))
-      {
-        window.handle_event(event);
+      cout << "Pipelined Frames" << endl;
 
-        free(event);
-      }
-      else
+      updater = thread([&]() {
+
+        try
+        {
+          while (game.running())
+          {
+            for(int ticks = pacer.ticks(FramePacer::clock::now()); ticks > 0; --ticks)
+            {
+              game.update(pacer.dt());
+            }
+
+            this_thread::sleep_until(pacer.next_tick());
+          }
+        }
+        catch(exception &e)
+        {
+          cout << "Critical Error: " << e.what() << endl;
+
+          game.terminate();
+        }
+      });
+    }
+
+    auto frameinterval = std::chrono::duration_cast<FramePacer::clock::duration>(std::chrono::nanoseconds(std::chrono::seconds(1)) / targetfps);
+
+    auto nextframe = FramePacer::clock::now();
+
+    auto cputime = cpu_seconds();
+
+    try
+    {
+      while (game.running())
       {
-        while (std::chrono::high_resolution_clock::now() > tick)
+        // every pending event in one batch
+
+        while (xcb_generic_event_t *event = xcb_poll_for_event(window.connection))
+        {
+          window.handle_event(event);
+
+          free(event);
+        }
+
+        auto now = FramePacer::clock::now();
+
+        if (blocking)
+        {
+          auto deadline = pipelined ? nextframe : std::min(nextframe, pacer.next_tick());
+
+          if (now < deadline)
+          {
+            wait_for_events(window.connection, deadline - now);
+
+            continue;
+          }
+        }
+
+        if (!pipelined)
         {
-          game.update(1.0f/hz);
+          for(int ticks = pacer.ticks(now); ticks > 0; --ticks)
+          {
+            game.update(pacer.dt());
+          }
+        }
+
+        if (blocking)
+        {
+          // woken for an update only
+
+          if (now < nextframe)
+            continue;
 
-          tick += dt;
+          nextframe = std::max(nextframe + frameinterval, now);
         }
 
+        auto acquirestart = FramePacer::clock::now();
+
         vulkan.acquire();
+
+        record_frametime(frame_times(), FrameTimes::Acquire, std::chrono::duration<float, milli>(FramePacer::clock::now() - acquirestart).count());
+
         game.render(vulkan.presentimages[vulkan.imageindex], vulkan.acquirecomplete, vulkan.rendercomplete, 0, 0, window.width, window.height);
+
+        auto presentstart = FramePacer::clock::now();
+
         vulkan.present();
+
+        game.presented();
+
+        now = FramePacer::clock::now();
+
+        record_frametime(frame_times(), FrameTimes::Present, std::chrono::duration<float, milli>(now - presentstart).count());
+
+        pacer.presented(now);
+
+        FramePacer::Report report;
+
+        if (pacer.report(now, report))
+        {
+          auto cpu = cpu_seconds();
+
+          cout << "Frames: " << report.frames << " late " << report.lateframes << " worst " << report.worstframe << "ms, ticks dropped " << report.droppedticks << " unseen " << report.unseenticks << ", cpu " << (int)(100 * (cpu - cputime) / report.elapsed) << "%" << (blocking ? " (blocking)" : " (polling)") << endl;
+
+          cputime = cpu;
+        }
       }
     }
+    catch(...)
+    {
+      game.terminate();
+
+      if (updater.joinable())
+        updater.join();
+
+      throw;
+    }
+
+    if (updater.joinable())
+      updater.join();
+
+    write_frametimes(frame_times(), "frametimes.json");
 
     vulkan.destroy();
   }
@@ -5,6 +5,10 @@
 #include "datumsponza.h"
 #include "fallback.h"
 #include "datum/debug.h"
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
 
 using namespace std;
 using namespace lml;
@@ -20,11 +24,154 @@ GameState::GameState(StackAllocator<> const &allocator)
 }
 
 
+///////////////////////// replicate_scene /////////////////////////////////
+void replicate_scene(GameState &state, int columns, int rows, bool jitter)
+{
+  // copies of the model meshes on a columns x rows grid, the loaded model is
+  // the first tile, jitter flips random tiles end for end
+
+  vector<Scene::EntityId> entities(state.scene.entities<MeshComponent>().begin(), state.scene.entities<MeshComponent>().end());
+
+  Vec3 mincorner(std::numeric_limits<float>::max());
+  Vec3 maxcorner(std::numeric_limits<float>::lowest());
+
+  for(auto &entity : entities)
+  {
+    auto bound = state.scene.get_component<MeshComponent>(entity).bound();
+
+    mincorner = lml::min(mincorner, bound.min);
+    maxcorner = lml::max(maxcorner, bound.max);
+  }
+
+  auto centre = 0.5f * (mincorner + maxcorner);
+  auto spacing = maxcorner - mincorner + Vec3(2.0f);
+
+  mt19937 random(columns * rows);
+
+  for(int j = 0; j < rows; ++j)
+  {
+    for(int i = 0; i < columns; ++i)
+    {
+      if (i == 0 && j == 0)
+        continue;
+
+      auto tile = Transform::translation(Vec3(i * spacing.x, 0.0f, j * spacing.z));
+
+      if (jitter && (random() & 1))
+      {
+        tile = tile * Transform::translation(centre) * Transform::rotation(Vec3(0, 1, 0), pi<float>()) * Transform::translation(-centre);
+      }
+
+      for(auto &entity : entities)
+      {
+        auto instance = state.scene.get_component<MeshComponent>(entity);
+        auto transform = state.scene.get_component<TransformComponent>(entity);
+
+        auto copy = state.scene.create<Entity>();
+        state.scene.add_component<TransformComponent>(copy, tile * transform.world());
+        state.scene.add_component<MeshComponent>(copy, instance.mesh(), instance.material(), MeshComponent::Visible | MeshComponent::Static);
+      }
+    }
+  }
+
+  invalidate_visibility(state.visibility);
+  invalidate_shadowcache(state.shadowcache);
+}
+
+
+///////////////////////// spawn_spheres /////////////////////////////////////
+void spawn_spheres(GameState &state, int count, Bound3 const &region)
+{
+  // dynamic unit spheres bobbing through the region, for benchmarking the
+  // dynamic cull and list paths
+
+  mt19937 random(count);
+
+  uniform_real_distribution<float> x(region.min.x, region.max.x), y(region.min.y, region.max.y), z(region.min.z, region.max.z), phase(0.0f, 2*pi<float>());
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto position = Vec3(x(random), y(random), z(random));
+
+    auto sphere = state.scene.create<Entity>();
+    state.scene.add_component<TransformComponent>(sphere, Transform::translation(position));
+    state.scene.add_component<MeshComponent>(sphere, state.unitsphere, state.defaultmaterial, MeshComponent::Visible);
+
+    state.spheres.push_back(make_tuple(sphere, position, phase(random)));
+  }
+}
+
+
+///////////////////////// load_scene ////////////////////////////////////////
+void load_scene(PlatformInterface &platform, GameState &state)
+{
+  // the model with its baked lod and visibility data, the component storage
+  // is expected to be initialised
+
+  auto model = state.assets.load(platform, "sponza.pack");
+
+  if (!model)
+    throw runtime_error("Model Assets Load Failure");
+
+  state.model = state.scene.load<Model>(platform, &state.resources, model);
+
+  state.floormaterial = state.scene.get<Model>(state.model)->materials[8];
+
+  auto lodpack = state.assets.load(platform, "sponza-lod.pack");
+
+  if (!load_meshlod(state.lods, state.assets, state.resources, state.scene.get<Model>(state.model), lodpack))
+    cout << "Mesh LOD: no lod pack matching the model, using model meshes" << endl;
+
+  // baked visibility, the pvs and the occluder triangles (pvsgen)
+
+  auto pvspack = state.assets.load(platform, "sponza-pvs.pack");
+
+  try
+  {
+    if (!pvspack)
+      throw runtime_error("Pack Load Failure");
+
+    load_occluders(platform, state.assets, state.assets.find(pvspack->id + 1), state.occluders);
+  }
+  catch(exception &e)
+  {
+    cout << "Occluders: " << e.what() << ", occlusion culling off" << endl;
+
+    state.occluders.clear();
+    state.occlusionculling = false;
+  }
+
+  try
+  {
+    if (!pvspack)
+      throw runtime_error("Pack Load Failure");
+
+    load_pvs(platform, state.assets, pvspack, state.pvs);
+  }
+  catch(exception &e)
+  {
+    cout << "PVS: " << e.what() << ", pvs off" << endl;
+
+    state.pvs = {};
+    state.pvsmode = GameState::PVSOff;
+  }
+
+  state.visibility.captureddynamics = true;
+
+  // the occluders are rendered opaque geometry, which the sun view does
+  // not draw, so only the camera view is occlusion culled
+
+  initialise_occlusion(state.occlusion[GameState::CameraView], 256, 144);
+}
+
+
 ///////////////////////// game_init /////////////////////////////////////////
 void datumsponza_init(PlatformInterface &platform)
 {
   cout << "Init" << endl;
 
+  cout << "Cull Kernel: " << cull_kernel_name() << endl;
+
   GameState &state = *new(allocate<GameState>(platform.gamememory)) GameState(platform.gamememory);
 
   assert(&state == platform.gamememory.data);
@@ -64,12 +211,42 @@ void datumsponza_init(PlatformInterface &platform)
 
   state.skybox = state.resources.create<SkyBox>(state.assets.find(CoreAsset::default_skybox));
 
-  auto model = state.assets.load(platform, "sponza.pack");
+  load_scene(platform, state);
 
-  if (!model)
-    throw runtime_error("Model Assets Load Failure");
+  // replication for scale testing, DATUMSPONZA_TILES=<columns>x<rows>,
+  // DATUMSPONZA_JITTER=1 and DATUMSPONZA_SPHERES=<count>
 
-  state.model = state.scene.load<Model>(platform, &state.resources, model);
+  if (auto tiles = getenv("DATUMSPONZA_TILES"))
+  {
+    int columns = 1, rows = 1;
+
+    if (sscanf(tiles, "%dx%d", &columns, &rows) != 2 || columns < 1 || rows < 1)
+      throw runtime_error("Invalid DATUMSPONZA_TILES");
+
+    auto jitter = getenv("DATUMSPONZA_JITTER");
+
+    replicate_scene(state, columns, rows, jitter && atoi(jitter) != 0);
+
+    cout << "Tiles: " << columns << "x" << rows << endl;
+  }
+
+  if (auto spheres = getenv("DATUMSPONZA_SPHERES"))
+  {
+    Vec3 mincorner(std::numeric_limits<float>::max());
+    Vec3 maxcorner(std::numeric_limits<float>::lowest());
+
+    for(auto &entity : state.scene.entities<MeshComponent>())
+    {
+      auto bound = state.scene.get_component<MeshComponent>(entity).bound();
+
+      mincorner = lml::min(mincorner, bound.min);
+      maxcorner = lml::max(maxcorner, bound.max);
+    }
+
+    spawn_spheres(state, atoi(spheres), Bound3(mincorner, maxcorner));
+
+    cout << "Spheres: " << state.spheres.size() << endl;
+  }
 
   auto fire = state.assets.load(platform, "fire.pack");
 
@@ -108,6 +285,15 @@ void datumsponza_init(PlatformInterface &platform)
   state.envmaps[2] = make_tuple(Vec3(-0.625f, 1.95f, -4.65f), Vec3(28.0f, 4.0f, 3.8f), state.resources.create<EnvMap>(state.assets.find(envmaps->id + 2)));
   state.envmaps[3] = make_tuple(Vec3(0.0f, 9.0f, 0.0f), Vec3(30.0f, 10.0f, 15.0f), state.resources.create<EnvMap>(state.assets.find(envmaps->id + 3)));
 
+  vector<Bound3> probes;
+
+  for(auto &envmap : state.envmaps)
+  {
+    probes.push_back(Bound3(get<0>(envmap) - 0.5f * get<1>(envmap), get<0>(envmap) + 0.5f * get<1>(envmap)));
+  }
+
+  build_probegrid(state.probegrid, probes.data(), probes.size(), 8.0f);
+
   //state.skybox = state.resources.create<SkyBox>(state.assets.find(envmaps->id + 0));
 
   //state.camera.lookat(Vec3(0, 1, 0), Vec3(1, 1, 0), Vec3(0, 1, 0));
@@ -115,6 +301,12 @@ void datumsponza_init(PlatformInterface &platform)
   state.camera.set_position(Vec3(-7.03893f, 5.22303f, 1.03818f));
   state.camera.set_rotation(Quaternion3(0.82396f, -0.0277191f, -0.56565f, -0.0190294f));
 
+  // the static tree is built once here, render culls without the scene
+
+  update_meshes(state.scene);
+
+  prepare_visibility(state.visibility, state.scene);
+
   state.mode = GameState::Startup;
 }
 
@@ -137,255 +329,633 @@ void datumsponza_resize(PlatformInterface &platform, Viewport const &viewport)
 }
 
 
-///////////////////////// buildgeometrylist /////////////////////////////////
-void buildgeometrylist(PlatformInterface &platform, GameState &state, GeometryList &meshes)
+///////////////////////// projected_pixels //////////////////////////////////
+float projected_pixels(GameState const &state, Bound3 const &bound)
 {
-  GeometryList::BuildState buildstate;
+  // projected radius in pixels from the camera
+
+  float scale = 0.5f * state.viewheight / tan(0.5f * state.frame->camera.fov());
 
-  if (meshes.begin(buildstate, state.rendercontext, state.resources))
+  float radius = 0.5f * norm(bound.max - bound.min);
+  float distance = std::max(dist(bound.centre(), state.frame->camera.position()), radius);
+
+  return scale * radius / distance;
+}
+
+
+///////////////////////// cullscene /////////////////////////////////////////
+void cullscene(PlatformInterface &platform, GameState &state, bool parallel)
+{
+  Frustum frustums[GameState::ViewCount];
+  OcclusionView views[1];
+
+  frustums[GameState::CameraView] = state.frame->camera.frustum();
+  views[GameState::CameraView] = occlusion_perspective(state.frame->camera.transform(), state.frame->camera.fov(), state.frame->camera.aspect(), state.frame->camera.znear());
+
+  Bound3 volume;
+  auto lightview = shadow_view(state.frame->camera, state.frame->sundirection, state.rendercontext.shadows.shadowsplitfar, volume);
+
+  frustums[GameState::SunView] = lightview * Frustum::orthographic(volume.min.x, volume.min.y, volume.max.x, volume.max.y, volume.min.z, volume.max.z);
+
+  state.visibility.dynamicitems = state.frame->dynamicitems;
+
+  if (state.occlusionculling)
   {
-    auto frustum = state.camera.frustum();
+    BEGIN_TIMED_BLOCK(Occluders, Color3(0.4f, 0.4f, 0.8f))
 
-    auto meshstorage = state.scene.system<MeshComponentStorage>();
-    auto transformstorage = state.scene.system<TransformComponentStorage>();
+    rasterise_occlusion(platform, state.occlusion, views, 1, state.occluders, parallel);
 
-    for(auto branch = meshstorage->tree().begin(), end = meshstorage->tree().end(); branch != end; ++branch)
-    {
-      if (intersects(frustum, branch.bound()))
-      {
-        if (contains(frustum, branch.bound()))
-        {
-          for(auto subtree = branch, end = next(branch); subtree != end; ++subtree)
-          {
-            for(auto &entity : subtree.items())
-            {
-              auto instance = meshstorage->get(entity);
-              auto transform = transformstorage->get(entity);
-
-              state.resources.request(platform, instance.mesh());
-              state.resources.request(platform, instance.material());
-
-              if (instance.mesh()->ready() && instance.material()->ready())
-              {
-                meshes.push_mesh(buildstate, transform.world(), instance.mesh(), instance.material());
-              }
-            }
-
-            subtree.descend();
-          }
-        }
-        else
-        {
-          for(auto &entity : branch.items())
-          {
-            auto instance = meshstorage->get(entity);
+    END_TIMED_BLOCK(Occluders)
+  }
 
-            if (intersects(frustum, instance.bound()))
-            {
-              auto transform = transformstorage->get(entity);
+  if (state.visibility.valid)
+  {
+    // candidate set of the camera cell, refreshed on a cell change or a
+    // rebuilt tree
 
-              state.resources.request(platform, instance.mesh());
-              state.resources.request(platform, instance.material());
+    int cell = (state.pvsmode != GameState::PVSOff) ? pvs_cell(state.pvs, state.frame->camera.position()) : -1;
 
-              if (instance.mesh()->ready() && instance.material()->ready())
-              {
-                meshes.push_mesh(buildstate, transform.world(), instance.mesh(), instance.material());
-              }
-            }
-          }
+    if (cell != state.pvscell || (cell >= 0 && state.visibility.candidates.size() != state.visibility.items.size()))
+    {
+      apply_pvs(state.visibility, state.pvs, cell);
 
-          branch.descend();
-        }
-      }
+      state.pvscell = cell;
     }
 
-    for(auto &entity : meshstorage->dynamic())
+    state.visibility.cullcandidates = (state.pvsmode == GameState::PVSCull);
+  }
+
+  // a current shadow cache holds the static casters, so the sun view only
+  // culls the dynamic items
+
+  bool shadowcached = state.shadowcaching && shadowcache_current(state.shadowcache, state.visibility, state.frame->sundirection, lightview, volume);
+
+  state.visibility.treeviews = shadowcached ? ~(1u << GameState::SunView) : ~0u;
+
+  BEGIN_TIMED_BLOCK(Cull, Color3(0.8f, 0.4f, 0.4f))
+
+  cull_visibility(state.visibility, frustums, state.occlusionculling ? state.occlusion : nullptr, GameState::ViewCount);
+
+  END_TIMED_BLOCK(Cull)
+
+  for(auto list : { ListStats::Geometry, ListStats::Casters })
+  {
+    auto &stats = state.visibility.viewstats[list == ListStats::Geometry ? GameState::CameraView : GameState::SunView];
+
+    state.liststats.lists[list].nodesvisited = stats.nodesvisited;
+    state.liststats.lists[list].nodesinside = stats.nodesinside;
+    state.liststats.lists[list].nodesrejected = stats.nodesrejected;
+    state.liststats.lists[list].itemstested = stats.itemstested;
+  }
+
+  auto &visible = state.visibility.visible;
+
+  state.rejecteddraws = 0;
+  state.rejectedcasters = 0;
+
+  if (state.contributionculling)
+  {
+    // drop items whose projected radius is under a pixel or two, before
+    // they cost a draw or a resource request
+
+    size_t count = 0;
+
+    for(size_t i = 0; i < visible.size(); ++i)
     {
-      auto instance = meshstorage->get(entity);
+      float pixels = projected_pixels(state, visible[i].item->bound);
 
-      if (intersects(frustum, instance.bound()))
+      if ((visible[i].views & (1 << GameState::CameraView)) && pixels < state.geometrythreshold)
       {
-        auto transform = transformstorage->get(entity);
+        visible[i].views &= ~(1 << GameState::CameraView);
 
-        state.resources.request(platform, instance.mesh());
-        state.resources.request(platform, instance.material());
+        state.rejecteddraws += 1;
+      }
 
-        if (instance.mesh()->ready() && instance.material()->ready())
-        {
-          meshes.push_mesh(buildstate, transform.world(), instance.mesh(), instance.material());
-        }
+      if ((visible[i].views & (1 << GameState::SunView)) && pixels < state.casterthreshold)
+      {
+        visible[i].views &= ~(1 << GameState::SunView);
+
+        state.rejectedcasters += 1;
+      }
+
+      if (visible[i].views != 0)
+      {
+        visible[count++] = visible[i];
       }
     }
 
-    meshes.finalise(buildstate);
+    visible.resize(count);
   }
-}
 
+  if (state.meshlod)
+  {
+    select_meshlod(state.lods, state.frame->camera, state.visibility, GameState::CameraView);
+  }
+  else
+  {
+    state.lods.geometrylevels.assign(visible.size(), 0);
+    state.lods.casterlevels.assign(visible.size(), 0);
+    state.lods.reduced = 0;
+  }
 
-///////////////////////// buildobjectlist ///////////////////////////////////
-void buildobjectlist(PlatformInterface &platform, GameState &state, ForwardList &objects)
-{
-  ForwardList::BuildState buildstate;
+  state.requests.clear();
 
-  if (objects.begin(buildstate, state.rendercontext, state.resources))
+  for(size_t i = 0; i < visible.size(); ++i)
   {
-    auto frustum = state.camera.frustum();
+    auto item = visible[i].item;
 
-    auto particlestorage = state.scene.system<ParticleSystemComponentStorage>();
+    state.requests.add(item->mesh);
+    state.requests.add(item->material);
 
-    for(auto &entity : particlestorage->entities())
+    if (visible[i].views & (1 << GameState::CameraView))
+      state.requests.add(lod_mesh(state.lods, item, state.lods.geometrylevels[i]));
+
+    if (visible[i].views & (1 << GameState::SunView))
+      state.requests.add(lod_mesh(state.lods, item, state.lods.casterlevels[i]));
+  }
+
+  if (state.shadowcaching)
+  {
+    // static casters are gathered once per light direction and region, each
+    // frame only selects the cached draws in the shadow volume
+
+    auto &cache = state.shadowcache;
+
+    if (!shadowcached)
     {
-      auto particles = particlestorage->get(entity);
+      gather_shadowcache(cache, state.visibility, state.frame->sundirection, lightview, volume);
 
-      if (intersects(frustum, particles.bound()))
+      for(size_t i = 0; i < cache.casters.size(); ++i)
       {
-        objects.push_particlesystem(buildstate, particles.system(), particles.instance());
+        auto item = &state.visibility.items[cache.casters[i]];
+
+        cache.drawsort.push(0, item->materialid, item->meshid * MeshLod::Levels, dot(item->bound.centre(), state.frame->sundirection), i);
       }
+
+      cache.drawsort.sort();
+
+      finalise_shadowcache(cache, state.visibility);
     }
 
-    objects.finalise(buildstate);
+    select_shadowcache(cache, frustums[GameState::SunView]);
+
+    for(size_t k = 0; k < cache.drawmasks.size(); ++k)
+    {
+      if (!cache.drawmasks[k])
+        continue;
+
+      auto item = &state.visibility.items[cache.casters[cache.drawsort.draws[k].index]];
+
+      if (state.contributionculling && projected_pixels(state, item->bound) < state.casterthreshold)
+      {
+        cache.drawmasks[k] = 0;
+
+        state.rejectedcasters += 1;
+
+        continue;
+      }
+
+      // per item levels as the uncached casters, the camera moves while
+      // the cache holds
+
+      if (state.meshlod)
+        cache.drawlevels[k] = caster_level(state.lods, state.frame->camera, state.visibility, cache.casters[cache.drawsort.draws[k].index]);
+
+      state.requests.add(lod_mesh(state.lods, item, cache.drawlevels[k]));
+      state.requests.add(item->material);
+    }
   }
 }
 
 
-///////////////////////// buildcasterlist ///////////////////////////////////
-void buildcasterlist(PlatformInterface &platform, GameState &state, CasterList &casters)
+///////////////////////// drawlevel /////////////////////////////////////////
+int drawlevel(GameState const &state, Visibility::Item const *item, int level)
+{
+  // finest loaded level at or below the selected one, the model mesh is
+  // always ready by the time an item is drawn
+
+  while (level > 0 && !lod_mesh(state.lods, item, level)->ready())
+    --level;
+
+  return level;
+}
+
+
+///////////////////////// buildgeometrylist /////////////////////////////////
+void buildgeometrylist(PlatformInterface &platform, GameState &state, GeometryList &meshes, GeometryList::BuildState &buildstate)
 {
-  CasterList::BuildState buildstate;
+  auto &visible = state.visibility.visible;
+  auto &drawsort = state.geometrysort;
 
-  if (casters.begin(buildstate, state.rendercontext, state.resources))
+  auto &stats = state.liststats.lists[ListStats::Geometry];
+
+  auto invview = inverse(state.frame->camera.transform());
+
+  drawsort.clear();
+
+  for(size_t i = 0; i < visible.size(); ++i)
   {
-    const float znear = 0.1f;
-    const float zfar = state.rendercontext.shadows.shadowsplitfar;
-    const float extrusion = 1000.0f;
+    auto item = visible[i].item;
 
-    auto camerafrustum = state.camera.frustum(znear, zfar + 1.0f);
+    if (visible[i].views & (1 << GameState::CameraView))
+    {
+      if (item->mesh->ready() && item->material->ready())
+      {
+        int level = drawlevel(state, item, state.lods.geometrylevels[i]);
 
-    auto lightpos = camerafrustum.centre() - extrusion * state.sundirection;
+        drawsort.push(0, item->materialid, item->meshid * MeshLod::Levels + level, -(invview * item->bound.centre()).z, i);
+      }
+      else
+      {
+        stats.notready += 1;
+      }
+    }
+  }
 
-    auto lightview = Transform::lookat(lightpos, lightpos + state.sundirection, Vec3(0, 1, 0));
+  stats.itemspushed = drawsort.draws.size();
 
-    auto invlightview = inverse(lightview);
+  if (state.sortdraws)
+  {
+    drawsort.sort();
+  }
 
-    Vec3 mincorner(std::numeric_limits<float>::max());
-    Vec3 maxcorner(std::numeric_limits<float>::lowest());
+  // repeated mesh and material pairs sit back to back after the sort, but
+  // GeometryList and CasterList only take single draws (push_mesh), so they
+  // stay one draw each until the renderer has an instanced push
 
-    for(size_t i = 1; i < 8; ++i)
+  Material const *material = nullptr;
+
+  state.materialchanges = 0;
+
+  for(auto &draw : drawsort.draws)
+  {
+    auto item = visible[draw.index].item;
+    auto mesh = lod_mesh(state.lods, item, drawlevel(state, item, state.lods.geometrylevels[draw.index]));
+
+    if (item->material != material)
     {
-      auto corner = invlightview * camerafrustum.corners[i];
+      state.materialchanges += 1;
 
-      mincorner = lml::min(mincorner, corner);
-      maxcorner = lml::max(maxcorner, corner);
+      material = item->material;
     }
 
-    auto frustum = lightview * Frustum::orthographic(mincorner.x, mincorner.y, maxcorner.x, maxcorner.y, 0.1f, extrusion + maxcorner.z - mincorner.z);
+    meshes.push_mesh(buildstate, item->transform, mesh, item->material);
+  }
+}
+
 
-    auto meshstorage = state.scene.system<MeshComponentStorage>();
-    auto transformstorage = state.scene.system<TransformComponentStorage>();
+///////////////////////// buildobjectlist ///////////////////////////////////
+void buildobjectlist(PlatformInterface &platform, GameState &state, ForwardList &objects, ForwardList::BuildState &buildstate)
+{
+  auto frustum = state.frame->camera.frustum();
 
-    for(auto branch = meshstorage->tree().begin(), end = meshstorage->tree().end(); branch != end; ++branch)
+  auto &stats = state.liststats.lists[ListStats::Forward];
+
+  for(auto &particles : state.frame->particles)
+  {
+    if (state.particlelod ? particle_visible(state.particles, particles.entity) : intersects(frustum, particles.transform * particles.system->bound))
     {
-      if (intersects(frustum, branch.bound()))
-      {
-        if (contains(frustum, branch.bound()))
-        {
-          for(auto subtree = branch, end = next(branch); subtree != end; ++subtree)
-          {
-            for(auto &entity : subtree.items())
-            {
-              auto instance = meshstorage->get(entity);
-              auto transform = transformstorage->get(entity);
-
-              state.resources.request(platform, instance.mesh());
-              state.resources.request(platform, instance.material());
-
-              if (instance.mesh()->ready() && instance.material()->ready())
-              {
-                casters.push_mesh(buildstate, transform.world(), instance.mesh(), instance.material());
-              }
-            }
-
-            subtree.descend();
-          }
-        }
-        else
-        {
-          for(auto &entity : branch.items())
-          {
-            auto instance = meshstorage->get(entity);
+      objects.push_particlesystem(buildstate, particles.system, particles.instance);
 
-            if (intersects(frustum, instance.bound()))
-            {
-              auto transform = transformstorage->get(entity);
+      stats.itemspushed += 1;
+    }
 
-              state.resources.request(platform, instance.mesh());
-              state.resources.request(platform, instance.material());
+    stats.itemstested += 1;
+  }
+}
 
-              if (instance.mesh()->ready() && instance.material()->ready())
-              {
-                casters.push_mesh(buildstate, transform.world(), instance.mesh(), instance.material());
-              }
-            }
-          }
 
-          branch.descend();
-        }
+///////////////////////// is_static /////////////////////////////////////////
+bool is_static(Visibility const &visibility, Visibility::Item const *item)
+{
+  return item >= visibility.items.data() && item < visibility.items.data() + visibility.items.size();
+}
+
+
+///////////////////////// buildcasterlist ///////////////////////////////////
+void buildcasterlist(PlatformInterface &platform, GameState &state, CasterList &casters, CasterList::BuildState &buildstate)
+{
+  auto &visible = state.visibility.visible;
+  auto &drawsort = state.castersort;
+
+  auto &stats = state.liststats.lists[ListStats::Casters];
+
+  drawsort.clear();
+
+  for(size_t i = 0; i < visible.size(); ++i)
+  {
+    auto item = visible[i].item;
+
+    if (state.shadowcaching && is_static(state.visibility, item))
+      continue;
+
+    if (visible[i].views & (1 << GameState::SunView))
+    {
+      if (item->mesh->ready() && item->material->ready())
+      {
+        int level = drawlevel(state, item, state.lods.casterlevels[i]);
+
+        drawsort.push(0, item->materialid, item->meshid * MeshLod::Levels + level, dot(item->bound.centre(), state.frame->sundirection), i);
+      }
+      else
+      {
+        stats.notready += 1;
       }
     }
+  }
+
+  stats.itemspushed = drawsort.draws.size();
+
+  if (state.sortdraws)
+  {
+    drawsort.sort();
+  }
+
+  for(auto &draw : drawsort.draws)
+  {
+    auto item = visible[draw.index].item;
+    auto mesh = lod_mesh(state.lods, item, drawlevel(state, item, state.lods.casterlevels[draw.index]));
 
-    for(auto &entity : meshstorage->dynamic())
+    casters.push_mesh(buildstate, item->transform, mesh, item->material);
+  }
+
+  if (state.shadowcaching)
+  {
+    auto &cache = state.shadowcache;
+
+    // readiness is checked here rather than at gather, so streaming does
+    // not force a gather
+
+    for(size_t k = 0; k < cache.drawmasks.size(); ++k)
     {
-      auto instance = meshstorage->get(entity);
+      if (!cache.drawmasks[k])
+        continue;
 
-      if (intersects(frustum, instance.bound()))
+      auto item = &state.visibility.items[cache.casters[cache.drawsort.draws[k].index]];
+
+      if (item->mesh->ready() && item->material->ready())
       {
-        auto transform = transformstorage->get(entity);
+        auto mesh = lod_mesh(state.lods, item, drawlevel(state, item, cache.drawlevels[k]));
 
-        state.resources.request(platform, instance.mesh());
-        state.resources.request(platform, instance.material());
+        casters.push_mesh(buildstate, item->transform, mesh, item->material);
 
-        if (instance.mesh()->ready() && instance.material()->ready())
-        {
-          casters.push_mesh(buildstate, transform.world(), instance.mesh(), instance.material());
-        }
+        stats.itemspushed += 1;
+      }
+      else
+      {
+        stats.notready += 1;
       }
     }
 
-    casters.finalise(buildstate);
+    stats.itemstested += cache.drawmasks.size();
   }
 }
 
 
 ///////////////////////// buildlightlist ////////////////////////////////////
-void buildlightlist(PlatformInterface &platform, GameState &state, LightList &lights)
+void buildlightlist(PlatformInterface &platform, GameState &state, LightList &lights, LightList::BuildState &buildstate)
 {
-  LightList::BuildState buildstate;
+  auto &pointlights = state.frame->lights;
 
-  if (lights.begin(buildstate, state.rendercontext, state.resources))
+  state.lightspheres.clear();
+
+  for(auto &light : pointlights)
   {
-    auto frustum = state.camera.frustum();
+    state.lightspheres.push_back(light.sphere);
+  }
 
-    auto lightstorage = state.scene.system<PointLightComponentStorage>();
-    auto transformstorage = state.scene.system<TransformComponentStorage>();
+  // occupancy culling, a light is only pushed when its view cluster range
+  // reaches a cluster holding visible geometry
 
-    for(auto &entity : lightstorage->entities())
+  prepare_occupancy(state.occupancy, state.frame->camera);
+
+  for(auto &visible : state.visibility.visible)
+  {
+    if (visible.views & (1 << GameState::CameraView))
     {
-      auto light = lightstorage->get(entity);
-      auto transform = transformstorage->get(entity);
+      occupy_clusters(state.occupancy, visible.item->bound);
+    }
+  }
 
-      if (intersects(frustum, Sphere(transform.world().translation(), light.range())))
-      {
-        lights.push_pointlight(buildstate, transform.world().translation(), light.range(), light.intensity(), light.attenuation());
-      }
+  select_lights(state.occupancy, state.lightspheres.data(), state.lightspheres.size());
+
+  state.occupiedlights = 0;
+
+  for(size_t i = 0; i < pointlights.size(); ++i)
+  {
+    if (state.occupancy.active[i])
+    {
+      auto &light = pointlights[i];
+
+      lights.push_pointlight(buildstate, light.sphere.centre, light.sphere.radius, light.intensity, light.attenuation);
+
+      state.occupiedlights += 1;
     }
+  }
 
-    for(auto &envmap : state.envmaps)
+  // probes, only those the probe grid finds around the visible geometry
+  // are frustum culled, then dropped unless they reach an occupied cluster
+
+  query_probegrid(state.probegrid, state.occupancy.bound, state.probecandidates);
+
+  CullBounds probebounds;
+
+  for(auto &i : state.probecandidates)
+  {
+    probebounds.push_back(state.probegrid.probes[i]);
+  }
+
+  state.probemasks.assign(probebounds.size(), 0);
+
+  cull_bounds(cull_planes(state.frame->camera.frustum()), probebounds, 0, probebounds.size(), 1, state.probemasks.data());
+
+  state.probes.clear();
+  state.probebounds.clear();
+
+  for(size_t k = 0; k < state.probecandidates.size(); ++k)
+  {
+    if (state.probemasks[k])
     {
+      state.probes.push_back(state.probecandidates[k]);
+      state.probebounds.push_back(state.probegrid.probes[state.probecandidates[k]]);
+    }
+  }
+
+  select_probes(state.occupancy, state.probebounds.data(), state.probebounds.size());
+
+  state.visibleprobes = 0;
+
+  for(size_t i = 0; i < state.probes.size(); ++i)
+  {
+    if (state.occupancy.probeactive[i])
+    {
+      auto &envmap = state.envmaps[state.probes[i]];
+
       lights.push_environment(buildstate, Transform::translation(get<0>(envmap)), get<1>(envmap), get<2>(envmap));
+
+      state.visibleprobes += 1;
     }
+  }
+
+  auto &stats = state.liststats.lists[ListStats::Lights];
+
+  stats.itemstested = pointlights.size() + state.probecandidates.size();
+  stats.itemspushed = state.occupiedlights + state.visibleprobes;
+}
+
+
+///////////////////////// ListBuild ///////////////////////////////////////
+template<typename List>
+struct ListBuild
+{
+  List &list;
+  typename List::BuildState buildstate;
 
-    lights.finalise(buildstate);
+  bool begun;
+};
+
+
+///////////////////////// build_job /////////////////////////////////////////
+template<typename List, void (*build)(PlatformInterface &, GameState &, List &, typename List::BuildState &)>
+void build_job(PlatformInterface &platform, void *ldata, void *rdata)
+{
+  GameState &state = *static_cast<GameState*>(ldata);
+  ListBuild<List> &job = *static_cast<ListBuild<List>*>(rdata);
+
+  build(platform, state, job.list, job.buildstate);
+
+  std::lock_guard<std::mutex> lock(state.joblock);
+
+  state.pendingjobs -= 1;
+
+  state.jobsdone.notify_all();
+}
+
+
+///////////////////////// buildrenderlists //////////////////////////////////
+void buildrenderlists(PlatformInterface &platform, GameState &state, CasterList &casters, GeometryList &geometry, ForwardList &objects, LightList &lights, bool parallel)
+{
+  clear_liststats(state.liststats);
+
+  // begin allocates from the resource manager, so every list is begun (and
+  // finalised) here on the render thread, the builders only push into the
+  // build state of their own list
+
+  ListBuild<CasterList> casterbuild = { casters, {}, false };
+  ListBuild<GeometryList> geometrybuild = { geometry, {}, false };
+  ListBuild<ForwardList> objectbuild = { objects, {}, false };
+  ListBuild<LightList> lightbuild = { lights, {}, false };
+
+  casterbuild.begun = casters.begin(casterbuild.buildstate, state.rendercontext, state.resources);
+  geometrybuild.begun = geometry.begin(geometrybuild.buildstate, state.rendercontext, state.resources);
+  objectbuild.begun = objects.begin(objectbuild.buildstate, state.rendercontext, state.resources);
+  lightbuild.begun = lights.begin(lightbuild.buildstate, state.rendercontext, state.resources);
+
+  if (parallel)
+  {
+    state.pendingjobs = objectbuild.begun + lightbuild.begun + casterbuild.begun;
+
+    if (objectbuild.begun)
+      platform.submit_work(build_job<ForwardList, buildobjectlist>, &state, &objectbuild);
+
+    cullscene(platform, state, parallel);
+
+    if (lightbuild.begun)
+      platform.submit_work(build_job<LightList, buildlightlist>, &state, &lightbuild);
+
+    if (casterbuild.begun)
+      platform.submit_work(build_job<CasterList, buildcasterlist>, &state, &casterbuild);
+
+    if (geometrybuild.begun)
+      buildgeometrylist(platform, state, geometry, geometrybuild.buildstate);
+
+    std::unique_lock<std::mutex> lock(state.joblock);
+
+    state.jobsdone.wait(lock, [&]() { return state.pendingjobs == 0; });
+  }
+  else
+  {
+    cullscene(platform, state, parallel);
+
+    if (casterbuild.begun)
+      buildcasterlist(platform, state, casters, casterbuild.buildstate);
+
+    if (geometrybuild.begun)
+      buildgeometrylist(platform, state, geometry, geometrybuild.buildstate);
+
+    if (objectbuild.begun)
+      buildobjectlist(platform, state, objects, objectbuild.buildstate);
+
+    if (lightbuild.begun)
+      buildlightlist(platform, state, lights, lightbuild.buildstate);
   }
+
+  if (casterbuild.begun)
+    casters.finalise(casterbuild.buildstate);
+
+  if (geometrybuild.begun)
+    geometry.finalise(geometrybuild.buildstate);
+
+  if (objectbuild.begun)
+    objects.finalise(objectbuild.buildstate);
+
+  if (lightbuild.begun)
+    lights.finalise(lightbuild.buildstate);
+
+  state.requests.submit(platform, state.resources);
+}
+
+
+///////////////////////// spawn_stresslights ////////////////////////////////
+void spawn_stresslights(GameState &state, int count)
+{
+  // extra point lights scattered through the atrium, for benchmarking
+
+  while ((int)state.stresslights.size() > count)
+  {
+    state.scene.destroy(state.stresslights.back());
+
+    state.stresslights.pop_back();
+  }
+
+  while ((int)state.stresslights.size() < count)
+  {
+    mt19937 random(state.stresslights.size());
+
+    uniform_real_distribution<float> x(-13.0f, 12.0f), y(0.0f, 10.0f), z(-5.5f, 5.5f), hue(0.2f, 0.6f);
+
+    auto light = state.scene.create<Entity>();
+    state.scene.add_component<TransformComponent>(light, Transform::translation(Vec3(x(random), y(random), z(random))));
+    state.scene.add_component<PointLightComponent>(light, Color3(1.0f, hue(random), 0.1f), Attenuation(0.4f, 0.0f, 1.0f));
+
+    state.stresslights.push_back(light);
+  }
+}
+
+
+///////////////////////// publish_snapshot //////////////////////////////////
+void publish_snapshot(GameState &state)
+{
+  auto &snapshot = begin_snapshot_write(state.snapshots);
+
+  snapshot.mode = state.mode;
+  snapshot.time = state.time;
+  snapshot.camera = state.camera;
+  snapshot.overlayinput = state.overlayinput;
+  snapshot.sundirection = state.sundirection;
+  snapshot.sunintensity = state.sunintensity;
+  snapshot.floorroughness = state.floorroughness;
+
+  snapshot.dynamicitems.clear();
+  capture_dynamic(state.scene, snapshot.dynamicitems);
+
+  snapshot.lights.clear();
+  capture_lights(state.scene, snapshot.lights);
+
+  snapshot.particles.clear();
+  capture_particles(state.scene, snapshot.particles);
+
+  end_snapshot_write(state.snapshots);
 }
 
 
@@ -403,7 +973,7 @@ void datumsponza_update(PlatformInterface &platform, GameInput const &input, flo
     state.resources.request(platform, state.loader);
     state.resources.request(platform, state.debugfont);
 
-    if (state.rendercontext.ready && state.loader->ready() && state.debugfont->ready())
+    if (state.renderready && state.loader->ready() && state.debugfont->ready())
     {
       state.mode = GameState::Load;
     }
@@ -423,17 +993,34 @@ void datumsponza_update(PlatformInterface &platform, GameInput const &input, flo
       request(platform, state.resources, get<2>(envmap), &ready, &total);
     }
 
+    CullBounds bounds;
+    vector<Scene::EntityId> entities;
+
     for(auto &entity : state.scene.entities<MeshComponent>())
     {
-      auto instance = state.scene.get_component<MeshComponent>(entity);
+      entities.push_back(entity);
+      bounds.push_back(state.scene.get_component<MeshComponent>(entity).bound());
+    }
+
+    vector<uint32_t> masks(bounds.size(), 0);
+
+    cull_bounds(cull_planes(state.camera.frustum()), bounds, 0, bounds.size(), 1, masks.data());
+
+    ResourceRequests requests;
 
-      if (intersects(state.camera.frustum(), instance.bound()))
+    for(size_t i = 0; i < bounds.size(); ++i)
+    {
+      if (masks[i])
       {
-        request(platform, state.resources, instance.mesh(), &ready, &total);
-        request(platform, state.resources, instance.material(), &ready, &total);
+        auto instance = state.scene.get_component<MeshComponent>(entities[i]);
+
+        requests.add(instance.mesh());
+        requests.add(instance.material());
       }
     }
 
+    requests.submit(platform, state.resources, &ready, &total);
+
     if (ready == total)
     {
       state.mode = GameState::Play;
@@ -446,7 +1033,29 @@ void datumsponza_update(PlatformInterface &platform, GameInput const &input, flo
 
     bool inputaccepted = false;
 
-    update_debug_overlay(input, &inputaccepted);
+    int stresslights = state.stresslights.size();
+    Color3 lampintensity = Color3(0.7257f, 0.2752f, 0.1001f);
+    float sunintensity = 12.0f;
+    float suntemperature = 3500.0f;
+    bool recordpath = state.recordpath;
+
+    {
+      // the debug menu is shared with render, read and written only here
+
+      std::lock_guard<std::mutex> menulock(state.menulock);
+
+      update_debug_overlay(input, &inputaccepted);
+
+      DEBUG_MENU_VALUE("Scene/Stress Lights", &stresslights, 0, 4096)
+      DEBUG_MENU_VALUE("Scene/Lamp Intensity", &lampintensity, Color3(0.0f, 0.0f, 0.0f), Color3(16.0f, 16.0f, 16.0f))
+      DEBUG_MENU_VALUE("Scene/Floor Roughness", &state.floorroughness, 0.0f, 1.0f)
+      DEBUG_MENU_VALUE("Lighting/Sun Intensity", &sunintensity, 0.0f, 16.0f);
+      DEBUG_MENU_VALUE("Lighting/Sun Temperature", &suntemperature, 1000.0f, 8000.0f);
+      DEBUG_MENU_ENTRY("Lighting/Sun Direction", state.sundirection = normalise(debug_menu_value("Lighting/Sun Direction", state.sundirection, Vec3(-1), Vec3(1))))
+      DEBUG_MENU_VALUE("Scene/Record Camera Path", &recordpath, false, true)
+    }
+
+    state.overlayinput = inputaccepted;
 
     if (!inputaccepted)
     {
@@ -480,12 +1089,14 @@ void datumsponza_update(PlatformInterface &platform, GameInput const &input, flo
         state.camera.offset(speed*Vec3(1, 0, 0));
     }
 
-    state.camera = adapt(state.camera, state.rendercontext.luminance, 0.1f, 0.5f*dt);
+    state.camera = adapt(state.camera, state.luminance, 0.1f, 0.5f*dt);
 
     state.camera = normalise(state.camera);
 
-    Color3 lampintensity = Color3(0.7257f, 0.2752f, 0.1001f);
-    DEBUG_MENU_VALUE("Scene/Lamp Intensity", &lampintensity, Color3(0.0f, 0.0f, 0.0f), Color3(16.0f, 16.0f, 16.0f))
+    if (stresslights != (int)state.stresslights.size())
+    {
+      spawn_stresslights(state, stresslights);
+    }
 
     for(auto &light : state.lights)
     {
@@ -494,26 +1105,51 @@ void datumsponza_update(PlatformInterface &platform, GameInput const &input, flo
       lightcomponent.set_intensity(lampintensity);
     }
 
-    float floorroughness = 1.0f;
-    DEBUG_MENU_VALUE("Scene/Floor Roughness", &floorroughness, 0.0f, 1.0f)
+    state.sunintensity = sunintensity * kelvin_rgb(suntemperature);
 
-    if (auto model = state.scene.get<Model>(state.model))
+    if (recordpath != state.recordpath)
     {
-      state.resources.update(model->materials[8], Color4(1.0f, 1.0f, 1.0f, 1.0f), 0.0f, floorroughness, 1.0f, 0.0f);
+      if (!recordpath)
+      {
+        // replayed by cullbench
+
+        try
+        {
+          state.camerapath.splitfar = state.rendersplitfar;
+          state.camerapath.viewheight = state.renderheight;
+
+          save_camerapath("camerapath.txt", state.camerapath);
+
+          cout << "Camera Path: " << state.camerapath.frames.size() << " frames" << endl;
+        }
+        catch(exception &e)
+        {
+          cout << "Camera Path: " << e.what() << endl;
+        }
+      }
+
+      state.camerapath.frames.clear();
+
+      state.recordpath = recordpath;
     }
 
-    float sunintensity = 12.0f;
-    float suntemperature = 3500.0f;
-    DEBUG_MENU_VALUE("Lighting/Sun Intensity", &sunintensity, 0.0f, 16.0f);
-    DEBUG_MENU_VALUE("Lighting/Sun Temperature", &suntemperature, 1000.0f, 8000.0f);
-    DEBUG_MENU_ENTRY("Lighting/Sun Direction", state.sundirection = normalise(debug_menu_value("Lighting/Sun Direction", state.sundirection, Vec3(-1), Vec3(1))))
+    if (state.recordpath)
+    {
+      state.camerapath.frames.push_back({ state.camera.position(), state.camera.rotation(), state.sundirection });
+    }
 
-    state.sunintensity = sunintensity * kelvin_rgb(suntemperature);
+    for(auto &sphere : state.spheres)
+    {
+      auto transform = state.scene.get_component<TransformComponent>(get<0>(sphere));
+
+      transform.set_local(Transform::translation(get<1>(sphere) + Vec3(0.0f, 0.5f * sin(state.time + get<2>(sphere)), 0.0f)));
+    }
 
     update_meshes(state.scene);
-    update_particlesystems(state.scene, state.camera, dt);
   }
 
+  publish_snapshot(state);
+
   if (input.keys[KB_KEY_ESCAPE].pressed())
   {
     platform.terminate();
@@ -532,9 +1168,73 @@ void datumsponza_render(PlatformInterface &platform, Viewport const &viewport)
 
   BEGIN_TIMED_BLOCK(Render, Color3(0.0f, 0.2f, 1.0f))
 
+  Snapshot const *previous = nullptr;
+
+  state.frame = begin_snapshot_read(state.snapshots, &previous);
+
+  Snapshot const *latest = state.frame;
+
+  // render draws from the snapshot and its own copies, the debug menu is the
+  // one thing shared with update, its values are taken here in one go
+
+  bool recordstats = state.liststats.csv.is_open();
+
+  RenderParams lighting;
+  lighting.ssaoscale = 0.0f;
+  lighting.fogdensity = 0.55f;
+  lighting.ssrstrength = 1.0f;
+
+  {
+    std::lock_guard<std::mutex> menulock(state.menulock);
+
+    DEBUG_MENU_VALUE("Render/Interpolation", &state.interpolation, false, true)
+    DEBUG_MENU_VALUE("Render/Late Latch", &state.latelatch, false, true)
+    DEBUG_MENU_VALUE("Render/Parallel Lists", &state.parallellists, false, true)
+    DEBUG_MENU_VALUE("Render/Cull Coherence", &state.visibility.coherencethreshold, 0.0f, 10.0f)
+    DEBUG_MENU_VALUE("Render/Occlusion Culling", &state.occlusionculling, false, true)
+    DEBUG_MENU_VALUE("Render/Sort Draws", &state.sortdraws, false, true)
+    DEBUG_MENU_VALUE("Render/Mesh LOD", &state.meshlod, false, true)
+    DEBUG_MENU_VALUE("Render/LOD Bias", &state.lods.bias, 0, MeshLod::Levels - 1)
+    DEBUG_MENU_VALUE("Render/Caster LOD Bias", &state.lods.casterbias, 0, MeshLod::Levels - 1)
+    DEBUG_MENU_VALUE("Render/Shadow Caching", &state.shadowcaching, false, true)
+    DEBUG_MENU_VALUE("Render/Contribution Culling", &state.contributionculling, false, true)
+    DEBUG_MENU_VALUE("Render/PVS (Off Cull Measure)", &state.pvsmode, 0, 2)
+    DEBUG_MENU_VALUE("Render/Geometry Threshold", &state.geometrythreshold, 0.0f, 8.0f)
+    DEBUG_MENU_VALUE("Render/Caster Threshold", &state.casterthreshold, 0.0f, 8.0f)
+    DEBUG_MENU_VALUE("Particles/LOD", &state.particlelod, false, true)
+    DEBUG_MENU_VALUE("Particles/Budget", &state.particles.budget, 0, 65536)
+    DEBUG_MENU_VALUE("Stats/Record CSV", &recordstats, false, true)
+    DEBUG_MENU_VALUE("Lighting/Fog Strength", &lighting.fogdensity, 0.0f, 10.0f)
+    DEBUG_MENU_VALUE("Lighting/Fog Attenuation", &lighting.fogattenuation.y, 0.0f, 10.0f)
+    DEBUG_MENU_VALUE("Lighting/Ambient Intensity", &lighting.ambientintensity, 0.0f, 1.0f)
+    DEBUG_MENU_VALUE("Lighting/Specular Intensity", &lighting.specularintensity, 0.0f, 1.0f)
+    DEBUG_MENU_VALUE("Lighting/SSR Strength", &lighting.ssrstrength, 0.0f, 80.0f)
+    DEBUG_MENU_VALUE("Lighting/Bloom Strength", &lighting.bloomstrength, 0.0f, 8.0f)
+  }
+
+  auto now = chrono::steady_clock::now();
+
+  if (state.frame)
+  {
+    float elapsed = chrono::duration<float>(now - state.lastrender).count();
+
+    state.rendertime = clamp(state.rendertime + elapsed, previous->time, state.frame->time);
+
+    if (state.interpolation && previous != state.frame && state.frame->time > previous->time)
+    {
+      interpolate_snapshot(state.renderframe, *previous, *state.frame, (state.rendertime - previous->time) / (state.frame->time - previous->time));
+
+      state.frame = &state.renderframe;
+    }
+  }
+
+  state.lastrender = now;
+
+  int mode = state.frame ? state.frame->mode : GameState::Startup;
+
   state.resourcetoken = state.resources.token();
 
-  if (state.mode == GameState::Startup)
+  if (mode == GameState::Startup)
   {
     if (prepare_render_context(platform, state.rendercontext, state.assets))
     {
@@ -551,7 +1251,7 @@ void datumsponza_render(PlatformInterface &platform, Viewport const &viewport)
     render_fallback(state.rendercontext, viewport, embeded::logo.data, embeded::logo.width, embeded::logo.height);
   }
 
-  if (state.mode == GameState::Load)
+  if (mode == GameState::Load)
   {
     RenderList renderlist(platform.renderscratchmemory, 8*1024*1024);
 
@@ -572,52 +1272,187 @@ void datumsponza_render(PlatformInterface &platform, Viewport const &viewport)
     render(state.rendercontext, viewport, Camera(), renderlist, renderparams);
   }
 
-  if (state.mode == GameState::Play)
+  if (mode == GameState::Play)
   {
-    auto &camera = state.camera;
+    auto &camera = state.frame->camera;
 
     asset_guard lock(state.assets);
 
+    state.viewheight = viewport.height;
+
     RenderList renderlist(platform.renderscratchmemory, 8*1024*1024);
 
-    CasterList casters;
-    buildcasterlist(platform, state, casters);
-    renderlist.push_casters(casters);
+    // particles are only ever drawn, so they step with the rendered
+    // snapshot rather than with update, which may be running ahead
 
-    GeometryList geometry;
-    buildgeometrylist(platform, state, geometry);
-    renderlist.push_geometry(geometry);
+    float particledt = std::max(state.frame->time - state.particletime, 0.0f);
 
-    ForwardList objects;
-    buildobjectlist(platform, state, objects);
-    renderlist.push_forward(objects);
+    if (state.particlelod)
+    {
+      update_particlelod(state.particles, state.frame->particles, camera, particledt);
+    }
+    else
+    {
+      update_particles(state.frame->particles, camera, particledt);
+    }
+
+    state.particletime = state.frame->time;
+
+    // resources are only changed here, the submit below reads them
+
+    if (state.floormaterial)
+    {
+      state.resources.update(state.floormaterial, Color4(1.0f, 1.0f, 1.0f, 1.0f), 0.0f, state.frame->floorroughness, 1.0f, 0.0f);
+    }
+
+    // late latch, the movement is applied again by the next update, so the
+    // simulation never sees it twice. The latch builds on the rotation of
+    // the latest snapshot, only the position stays interpolated, a blended
+    // rotation lags the deltas and judders
+
+    LateInput late;
+
+    if (state.latelatch && !state.frame->overlayinput && sample_late_input(platform, late) && late.leftbutton)
+    {
+      if (state.frame != &state.renderframe)
+      {
+        state.renderframe = *state.frame;
+
+        state.frame = &state.renderframe;
+      }
+
+      state.renderframe.camera.set_rotation(latest->camera.rotation());
 
+      state.renderframe.camera.yaw(-1.5f * late.deltamousex, Vec3(0, 1, 0));
+      state.renderframe.camera.pitch(-1.5f * late.deltamousey);
+
+      state.renderframe.camera = normalise(state.renderframe.camera);
+    }
+
+    CasterList casters;
+    GeometryList geometry;
+    ForwardList objects;
     LightList lights;
-    buildlightlist(platform, state, lights);
+
+    auto liststart = chrono::high_resolution_clock::now();
+
+    BEGIN_TIMED_BLOCK(Lists, Color3(0.4f, 0.8f, 0.4f))
+
+    buildrenderlists(platform, state, casters, geometry, objects, lights, state.parallellists);
+
+    END_TIMED_BLOCK(Lists)
+
+    auto listtime = chrono::duration<float, milli>(chrono::high_resolution_clock::now() - liststart).count();
+
+    if (recordstats != state.liststats.csv.is_open())
+    {
+      if (recordstats)
+        start_liststats(state.liststats, "liststats.csv");
+      else
+        stop_liststats(state.liststats);
+    }
+
+    record_liststats(state.liststats, listtime);
+
+    auto &liststats = state.liststats.lists;
+
+    auto updatetimes = frametime_percentiles(frame_times(), FrameTimes::Update);
+    auto rendertimes = frametime_percentiles(frame_times(), FrameTimes::Render);
+    auto acquiretimes = frametime_percentiles(frame_times(), FrameTimes::Acquire);
+    auto presenttimes = frametime_percentiles(frame_times(), FrameTimes::Present);
+    auto inputframe = frametime_percentiles(frame_times(), FrameTimes::InputToFrame);
+    auto inputsubmit = frametime_percentiles(frame_times(), FrameTimes::InputToSubmit);
+    auto inputpresent = frametime_percentiles(frame_times(), FrameTimes::InputToPresent);
+
+    renderlist.push_casters(casters);
+    renderlist.push_geometry(geometry);
+    renderlist.push_forward(objects);
     renderlist.push_lights(lights);
 
-    RenderParams renderparams;
+    RenderParams renderparams = lighting;
     renderparams.skybox = state.skybox;
-    renderparams.sundirection = state.sundirection;
-    renderparams.sunintensity = state.sunintensity;
-    renderparams.skyboxorientation = Transform::rotation(Vec3(0, 1, 0), -0.1f*state.time);
-    renderparams.ssaoscale = 0.0f;
-    renderparams.fogdensity = 0.55f;
-    renderparams.ssrstrength = 1.0f;
-
-    DEBUG_MENU_VALUE("Lighting/Fog Strength", &renderparams.fogdensity, 0.0f, 10.0f)
-    DEBUG_MENU_VALUE("Lighting/Fog Attenuation", &renderparams.fogattenuation.y, 0.0f, 10.0f)
-    DEBUG_MENU_VALUE("Lighting/Ambient Intensity", &renderparams.ambientintensity, 0.0f, 1.0f)
-    DEBUG_MENU_VALUE("Lighting/Specular Intensity", &renderparams.specularintensity, 0.0f, 1.0f)
-    DEBUG_MENU_VALUE("Lighting/SSR Strength", &renderparams.ssrstrength, 0.0f, 80.0f)
-    DEBUG_MENU_VALUE("Lighting/Bloom Strength", &renderparams.bloomstrength, 0.0f, 8.0f)
+    renderparams.sundirection = state.frame->sundirection;
+    renderparams.sunintensity = state.frame->sunintensity;
+    renderparams.skyboxorientation = Transform::rotation(Vec3(0, 1, 0), -0.1f*state.frame->time);
 
-    render_debug_overlay(state.rendercontext, state.resources, renderlist, viewport, state.debugfont);
+    {
+      std::lock_guard<std::mutex> menulock(state.menulock);
+
+      DEBUG_MENU_ENTRY("Stats/Occluded Items", (int)state.visibility.occludeditems)
+      DEBUG_MENU_ENTRY("Stats/Geometry/Nodes Visited", (int)liststats[ListStats::Geometry].nodesvisited)
+      DEBUG_MENU_ENTRY("Stats/Geometry/Nodes Inside", (int)liststats[ListStats::Geometry].nodesinside)
+      DEBUG_MENU_ENTRY("Stats/Geometry/Nodes Rejected", (int)liststats[ListStats::Geometry].nodesrejected)
+      DEBUG_MENU_ENTRY("Stats/Geometry/Items Tested", (int)liststats[ListStats::Geometry].itemstested)
+      DEBUG_MENU_ENTRY("Stats/Geometry/Items Pushed", (int)liststats[ListStats::Geometry].itemspushed)
+      DEBUG_MENU_ENTRY("Stats/Geometry/Not Ready", (int)liststats[ListStats::Geometry].notready)
+      DEBUG_MENU_ENTRY("Stats/Casters/Nodes Visited", (int)liststats[ListStats::Casters].nodesvisited)
+      DEBUG_MENU_ENTRY("Stats/Casters/Nodes Inside", (int)liststats[ListStats::Casters].nodesinside)
+      DEBUG_MENU_ENTRY("Stats/Casters/Nodes Rejected", (int)liststats[ListStats::Casters].nodesrejected)
+      DEBUG_MENU_ENTRY("Stats/Casters/Items Tested", (int)liststats[ListStats::Casters].itemstested)
+      DEBUG_MENU_ENTRY("Stats/Casters/Items Pushed", (int)liststats[ListStats::Casters].itemspushed)
+      DEBUG_MENU_ENTRY("Stats/Casters/Not Ready", (int)liststats[ListStats::Casters].notready)
+      DEBUG_MENU_ENTRY("Stats/Forward/Items Tested", (int)liststats[ListStats::Forward].itemstested)
+      DEBUG_MENU_ENTRY("Stats/Forward/Items Pushed", (int)liststats[ListStats::Forward].itemspushed)
+      DEBUG_MENU_ENTRY("Stats/Lights/Items Tested", (int)liststats[ListStats::Lights].itemstested)
+      DEBUG_MENU_ENTRY("Stats/Lights/Items Pushed", (int)liststats[ListStats::Lights].itemspushed)
+
+      DEBUG_MENU_ENTRY("Frame Times/Update/p50", updatetimes.p50)
+      DEBUG_MENU_ENTRY("Frame Times/Update/p95", updatetimes.p95)
+      DEBUG_MENU_ENTRY("Frame Times/Update/p99", updatetimes.p99)
+      DEBUG_MENU_ENTRY("Frame Times/Update/Max", updatetimes.max)
+      DEBUG_MENU_ENTRY("Frame Times/Render/p50", rendertimes.p50)
+      DEBUG_MENU_ENTRY("Frame Times/Render/p95", rendertimes.p95)
+      DEBUG_MENU_ENTRY("Frame Times/Render/p99", rendertimes.p99)
+      DEBUG_MENU_ENTRY("Frame Times/Render/Max", rendertimes.max)
+      DEBUG_MENU_ENTRY("Frame Times/Acquire/p50", acquiretimes.p50)
+      DEBUG_MENU_ENTRY("Frame Times/Acquire/p95", acquiretimes.p95)
+      DEBUG_MENU_ENTRY("Frame Times/Acquire/p99", acquiretimes.p99)
+      DEBUG_MENU_ENTRY("Frame Times/Acquire/Max", acquiretimes.max)
+      DEBUG_MENU_ENTRY("Frame Times/Present/p50", presenttimes.p50)
+      DEBUG_MENU_ENTRY("Frame Times/Present/p95", presenttimes.p95)
+      DEBUG_MENU_ENTRY("Frame Times/Present/p99", presenttimes.p99)
+      DEBUG_MENU_ENTRY("Frame Times/Present/Max", presenttimes.max)
+      DEBUG_MENU_ENTRY("Input Latency/Frame/p50", inputframe.p50)
+      DEBUG_MENU_ENTRY("Input Latency/Frame/p95", inputframe.p95)
+      DEBUG_MENU_ENTRY("Input Latency/Frame/p99", inputframe.p99)
+      DEBUG_MENU_ENTRY("Input Latency/Frame/Max", inputframe.max)
+      DEBUG_MENU_ENTRY("Input Latency/Submit/p50", inputsubmit.p50)
+      DEBUG_MENU_ENTRY("Input Latency/Submit/p95", inputsubmit.p95)
+      DEBUG_MENU_ENTRY("Input Latency/Submit/p99", inputsubmit.p99)
+      DEBUG_MENU_ENTRY("Input Latency/Submit/Max", inputsubmit.max)
+      DEBUG_MENU_ENTRY("Input Latency/Present/p50", inputpresent.p50)
+      DEBUG_MENU_ENTRY("Input Latency/Present/p95", inputpresent.p95)
+      DEBUG_MENU_ENTRY("Input Latency/Present/p99", inputpresent.p99)
+      DEBUG_MENU_ENTRY("Input Latency/Present/Max", inputpresent.max)
+
+      DEBUG_MENU_ENTRY("Stats/Material Changes", state.materialchanges)
+      DEBUG_MENU_ENTRY("Stats/Reduced Meshes", state.lods.reduced)
+      DEBUG_MENU_ENTRY("Stats/Shadow Gathers", state.shadowcache.gathers)
+      DEBUG_MENU_ENTRY("Stats/Rejected Draws", state.rejecteddraws)
+      DEBUG_MENU_ENTRY("Stats/Rejected Casters", state.rejectedcasters)
+      DEBUG_MENU_ENTRY("Stats/PVS Removed", (int)state.visibility.noncandidates)
+      DEBUG_MENU_ENTRY("Stats/Redundant Requests", (int)state.requests.redundant)
+      DEBUG_MENU_ENTRY("Stats/Occupied Lights", state.occupiedlights)
+      DEBUG_MENU_ENTRY("Stats/Visible Probes", state.visibleprobes)
+      DEBUG_MENU_ENTRY("Stats/Particle Updates", state.particles.simulated)
+      DEBUG_MENU_ENTRY("Stats/Particle Budget Used", state.particles.particles)
+
+      render_debug_overlay(state.rendercontext, state.resources, renderlist, viewport, state.debugfont);
+    }
 
-    render(state.rendercontext, viewport, camera, renderlist, renderparams);
+    render(state.rendercontext, viewport, state.frame->camera, renderlist, renderparams);
   }
 
   state.resources.release(state.resourcetoken);
 
+  end_snapshot_read(state.snapshots);
+
+  state.frame = nullptr;
+
+  state.renderready = state.rendercontext.ready;
+  state.luminance = state.rendercontext.luminance;
+  state.renderheight = state.viewheight;
+  state.rendersplitfar = state.rendercontext.shadows.shadowsplitfar;
+
   END_TIMED_BLOCK(Render)
 }
@@ -9,6 +9,23 @@
 #include "datum/math.h"
 #include "datum/scene.h"
 #include "datum/renderer.h"
+#include "visibility.h"
+#include "drawsort.h"
+#include "resourcerequests.h"
+#include "lightoccupancy.h"
+#include "particlelod.h"
+#include "meshlod.h"
+#include "shadowcache.h"
+#include "liststats.h"
+#include "camerapath.h"
+#include "pvs.h"
+#include "snapshot.h"
+#include "frametimes.h"
+#include "lateinput.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 //|---------------------- GameState -----------------------------------------
 //|--------------------------------------------------------------------------
@@ -55,10 +72,138 @@ struct GameState
   Scene::EntityId model;
   Scene::EntityId lights[4];
 
+  Material const *floormaterial = nullptr;
+
+  enum { CameraView, SunView, ViewCount };
+
+  Visibility visibility;
+
+  std::vector<lml::Vec3> occluders;
+
+  Occlusion occlusion[ViewCount];
+
+  bool occlusionculling = true;
+
+  DrawSort geometrysort;
+  DrawSort castersort;
+
+  bool sortdraws = true;
+
+  int materialchanges = 0;
+
+  ResourceRequests requests;
+
+  MeshLod lods;
+
+  bool meshlod = true;
+
+  ShadowCache shadowcache;
+
+  bool shadowcaching = true;
+
+  int viewheight = 1080;
+
+  bool contributionculling = true;
+
+  float geometrythreshold = 1.0f;   // projected radius in pixels, smaller draws are dropped
+  float casterthreshold = 2.0f;
+
+  int rejecteddraws = 0;
+  int rejectedcasters = 0;
+
+  ListStats liststats;
+
+  CameraPath camerapath;
+
+  bool recordpath = false;
+
+  PVS pvs;
+
+  enum { PVSOff, PVSCull, PVSMeasure };
+
+  int pvsmode = PVSCull;
+  int pvscell = -1;
+
+  LightOccupancy occupancy;
+
+  std::vector<lml::Sphere> lightspheres;
+
+  int occupiedlights = 0;
+
+  ProbeGrid probegrid;
+
+  std::vector<size_t> probecandidates;
+  std::vector<uint32_t> probemasks;
+
+  std::vector<size_t> probes;
+  std::vector<lml::Bound3> probebounds;
+
+  int visibleprobes = 0;
+
+  std::vector<Scene::EntityId> stresslights;
+
+  std::vector<std::tuple<Scene::EntityId, lml::Vec3, float>> spheres;   // entity, rest position, phase
+
+  float floorroughness = 1.0f;
+
+  ParticleLod particles;
+
+  bool particlelod = true;
+
+  bool parallellists = true;
+
+  // update publishes a snapshot at the end of each tick, render draws the
+  // newest one, so the two can run on separate threads. Render reads no
+  // scene state, the debug menu is the only thing shared and menulock is
+  // held just while either side reads or writes its values
+
+  SnapshotBuffer snapshots;
+
+  std::mutex menulock;
+
+  Snapshot const *frame = nullptr;    // being rendered
+
+  // renders blend the two newest snapshots at a presentation clock that
+  // follows real time, held between the two snapshot times
+
+  bool interpolation = true;
+
+  // renders may also apply mouse movement the next update has not yet
+  // taken to their copy of the camera
+
+  bool latelatch = false;
+
+  bool overlayinput = false;          // last update input was taken by the overlay
+
+  Snapshot renderframe;               // blended or latched copy of the frame
+
+  float rendertime = 0;
+  std::chrono::steady_clock::time_point lastrender;
+
+  float particletime = 0;             // snapshot time the particles are stepped to
+
+  // render feedback for update
+
+  std::atomic<bool> renderready{false};
+  std::atomic<float> luminance{1.0f};
+  std::atomic<int> renderheight{1080};
+  std::atomic<float> rendersplitfar{0.0f};
+
   size_t resourcetoken = 0;
+
+  // list build jobs still running, render blocks on jobsdone
+
+  int pendingjobs = 0;
+  std::mutex joblock;
+  std::condition_variable jobsdone;
 };
 
 
+// scene loading and culling, shared with cullbench
+
+void load_scene(DatumPlatform::PlatformInterface &platform, GameState &state);
+void cullscene(DatumPlatform::PlatformInterface &platform, GameState &state, bool parallel);
+
 void datumsponza_init(DatumPlatform::PlatformInterface &platform);
 void datumsponza_resize(DatumPlatform::PlatformInterface &platform, DatumPlatform::Viewport const &viewport);
 void datumsponza_update(DatumPlatform::PlatformInterface &platform, DatumPlatform::GameInput const &input, float dt);
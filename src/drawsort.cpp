@@ -0,0 +1,88 @@
+//
+// drawsort.cpp
+//
+
+#include "drawsort.h"
+#include <algorithm>
+
+using namespace std;
+
+
+///////////////////////// DrawSort::clear ///////////////////////////////////
+void DrawSort::clear()
+{
+  draws.clear();
+  depths.clear();
+}
+
+
+///////////////////////// DrawSort::push ////////////////////////////////////
+void DrawSort::push(uint32_t pass, uint32_t material, uint32_t mesh, float depth, uint32_t index)
+{
+  uint64_t key = 0;
+
+  // ids too wide for their fields would alias other runs, such a draw is
+  // kept with an empty key, ahead of the sorted runs in depth order only
+
+  if (pass < (1 << 4) && material < (1 << 20) && mesh < (1 << 24))
+    key = (uint64_t)pass << 60 | (uint64_t)material << 40 | (uint64_t)mesh << 16;
+
+  draws.push_back({ key, index });
+  depths.push_back(depth);
+}
+
+
+///////////////////////// DrawSort::sort ////////////////////////////////////
+void DrawSort::sort()
+{
+  if (draws.empty())
+    return;
+
+  auto range = minmax_element(depths.begin(), depths.end());
+
+  double lo = *range.first;
+  double scale = (*range.second > lo) ? 65535.0 / (*range.second - lo) : 0.0;
+
+  for(size_t i = 0; i < draws.size(); ++i)
+  {
+    draws[i].key |= (uint64_t)((depths[i] - lo) * scale) & 0xFFFF;
+  }
+
+  // lsd radix sort, eight bit digits, skipping digits the keys all share
+
+  size_t counts[8][256] = {};
+
+  for(auto &draw : draws)
+  {
+    for(int digit = 0; digit < 8; ++digit)
+    {
+      counts[digit][(draw.key >> (8 * digit)) & 0xFF] += 1;
+    }
+  }
+
+  scratch.resize(draws.size());
+
+  for(int digit = 0; digit < 8; ++digit)
+  {
+    auto &count = counts[digit];
+
+    if (count[(draws[0].key >> (8 * digit)) & 0xFF] == draws.size())
+      continue;
+
+    size_t offsets[256];
+
+    for(size_t bucket = 0, sum = 0; bucket < 256; ++bucket)
+    {
+      offsets[bucket] = sum;
+      sum += count[bucket];
+    }
+
+    for(auto &draw : draws)
+    {
+      scratch[offsets[(draw.key >> (8 * digit)) & 0xFF]++] = draw;
+    }
+
+    swap(draws, scratch);
+  }
+}
+
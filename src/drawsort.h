@@ -0,0 +1,44 @@
+//
+// drawsort.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include <vector>
+#include <cstdint>
+
+//|---------------------- DrawSort ------------------------------------------
+//|--------------------------------------------------------------------------
+
+struct DrawSort
+{
+  // key layout, high to low : pass (4) material (20) mesh (24) depth (16)
+  //
+  // ids that do not fit their fields push an unsorted draw (empty key)
+  //
+  // depth only orders draws within a run sharing pass, material and mesh,
+  // so a list is front to back per run, not front to back overall
+
+  struct Draw
+  {
+    uint64_t key;
+    uint32_t index;
+  };
+
+  std::vector<Draw> draws;
+
+  void clear();
+
+  void push(uint32_t pass, uint32_t material, uint32_t mesh, float depth, uint32_t index);
+
+  // quantises the depths over their range to 16 bits and radix sorts by key
+
+  void sort();
+
+  // scratch
+
+  std::vector<Draw> scratch;
+  std::vector<float> depths;
+};
@@ -0,0 +1,145 @@
+//
+// frametimes.cpp
+//
+
+#include "frametimes.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace
+{
+  const float MinTime = 0.01f;
+  const float Growth = 1.01f;
+
+  const char *stagenames[FrameTimes::StageCount] = { "update", "render", "acquire", "present", "input_to_frame", "input_to_submit", "input_to_present" };
+
+  ///////////////////////// bucket ////////////////////////////////////////////
+  int bucket(float ms)
+  {
+    if (ms <= MinTime)
+      return 0;
+
+    return std::min((int)(log(ms / MinTime) / log(Growth)), FrameTimes::Buckets - 1);
+  }
+
+  ///////////////////////// percentile ////////////////////////////////////////
+  float percentile(FrameTimes::Histogram const &histogram, float fraction)
+  {
+    if (histogram.total == 0)
+      return 0.0f;
+
+    // upper edge of the bucket holding the sample, capped by the max
+
+    size_t rank = std::max((size_t)ceil(fraction * histogram.total), size_t(1));
+
+    size_t count = 0;
+
+    for(int i = 0; i < FrameTimes::Buckets; ++i)
+    {
+      count += histogram.counts[i];
+
+      if (count >= rank)
+        return std::min(MinTime * pow(Growth, (float)(i + 1)), histogram.max);
+    }
+
+    return histogram.max;
+  }
+}
+
+
+///////////////////////// frame_times ///////////////////////////////////////
+FrameTimes &frame_times()
+{
+  static FrameTimes times;
+
+  return times;
+}
+
+
+///////////////////////// record_frametime //////////////////////////////////
+void record_frametime(FrameTimes &times, FrameTimes::Stage stage, float ms)
+{
+  lock_guard<mutex> lock(times.lock);
+
+  auto &track = times.stages[stage];
+
+  auto &slot = track.samples[track.recorded % FrameTimes::Window];
+
+  if (track.recorded >= FrameTimes::Window)
+  {
+    track.window.counts[bucket(slot)] -= 1;
+    track.window.total -= 1;
+    track.window.sum -= slot;
+  }
+
+  slot = ms;
+
+  track.window.counts[bucket(ms)] += 1;
+  track.window.total += 1;
+  track.window.sum += ms;
+
+  track.run.counts[bucket(ms)] += 1;
+  track.run.total += 1;
+  track.run.sum += ms;
+  track.run.max = std::max(track.run.max, ms);
+
+  track.recorded += 1;
+}
+
+
+///////////////////////// frametime_percentiles /////////////////////////////
+FramePercentiles frametime_percentiles(FrameTimes &times, FrameTimes::Stage stage)
+{
+  lock_guard<mutex> lock(times.lock);
+
+  auto &track = times.stages[stage];
+
+  // window max is not kept incrementally, it comes from the ring
+
+  track.window.max = 0.0f;
+
+  for(size_t i = 0; i < std::min(track.recorded, size_t(FrameTimes::Window)); ++i)
+  {
+    track.window.max = std::max(track.window.max, track.samples[i]);
+  }
+
+  return { percentile(track.window, 0.50f), percentile(track.window, 0.95f), percentile(track.window, 0.99f), track.window.max };
+}
+
+
+///////////////////////// write_frametimes //////////////////////////////////
+void write_frametimes(FrameTimes &times, const char *path)
+{
+  lock_guard<mutex> lock(times.lock);
+
+  ofstream fout(path, ios::trunc);
+
+  if (!fout)
+  {
+    cout << "Frame Times: unable to open " << path << endl;
+    return;
+  }
+
+  fout << "{\n";
+  fout << "  \"units\": \"ms\",\n";
+
+  for(int stage = 0; stage < FrameTimes::StageCount; ++stage)
+  {
+    auto &run = times.stages[stage].run;
+
+    fout << "  \"" << stagenames[stage] << "\": { ";
+    fout << "\"count\": " << run.total << ", ";
+    fout << "\"mean\": " << (run.total != 0 ? run.sum / run.total : 0.0) << ", ";
+    fout << "\"p50\": " << percentile(run, 0.50f) << ", ";
+    fout << "\"p95\": " << percentile(run, 0.95f) << ", ";
+    fout << "\"p99\": " << percentile(run, 0.99f) << ", ";
+    fout << "\"max\": " << run.max << " }";
+    fout << (stage + 1 < FrameTimes::StageCount ? ",\n" : "\n");
+  }
+
+  fout << "}\n";
+}
@@ -0,0 +1,65 @@
+//
+// frametimes.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include <mutex>
+
+//|---------------------- FrameTimes ----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct FrameTimes
+{
+  // the frame stages, then input latency from the oldest event a frame
+  // used to the start of that frame, its submit and its present
+
+  enum Stage { Update, Render, Acquire, Present, InputToFrame, InputToSubmit, InputToPresent, StageCount };
+
+  // geometric buckets, 1% wide from 10us, good to about 1.5s
+
+  enum { Buckets = 1200, Window = 600 };
+
+  struct Histogram
+  {
+    uint32_t counts[Buckets];
+
+    size_t total;
+    double sum;
+    float max;
+  };
+
+  struct Track
+  {
+    float samples[Window];    // ring, the last Window samples (ms)
+    size_t recorded;
+
+    Histogram window;         // over the ring
+    Histogram run;            // over every sample
+  };
+
+  Track stages[StageCount] = {};
+
+  std::mutex lock;
+};
+
+struct FramePercentiles
+{
+  float p50, p95, p99, max;   // ms
+};
+
+// process wide, recorded by the platform loop (from the update and render
+// threads) and read by the debug overlay
+
+FrameTimes &frame_times();
+
+void record_frametime(FrameTimes &times, FrameTimes::Stage stage, float ms);
+
+// over the rolling window
+
+FramePercentiles frametime_percentiles(FrameTimes &times, FrameTimes::Stage stage);
+
+// json summary over the whole run
+
+void write_frametimes(FrameTimes &times, const char *path);
@@ -0,0 +1,49 @@
+//
+// lateinput.h
+//
+
+#pragma once
+
+#include "datum.h"
+
+//|---------------------- LateInput -----------------------------------------
+//|--------------------------------------------------------------------------
+
+// mouse input registered since the last update took its input, for a
+// render that applies it to its own copy of the camera (late latching)
+
+struct LateInput
+{
+  float deltamousex;
+  float deltamousey;
+
+  bool leftbutton;          // held, as of the newest press or release
+};
+
+// implemented alongside PlatformInterface by platforms that own an input
+// buffer and can sample it between updates
+
+class LateInputPlatform
+{
+  public:
+
+    virtual void sample_late_input(LateInput &input) = 0;
+
+  protected:
+
+    ~LateInputPlatform() = default;
+};
+
+// false when the platform has no late input
+
+inline bool sample_late_input(DatumPlatform::PlatformInterface &platform, LateInput &input)
+{
+  auto lateplatform = dynamic_cast<LateInputPlatform*>(&platform);
+
+  if (!lateplatform)
+    return false;
+
+  lateplatform->sample_late_input(input);
+
+  return true;
+}
@@ -0,0 +1,288 @@
+//
+// lightoccupancy.cpp
+//
+
+#include "lightoccupancy.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace lml;
+
+namespace
+{
+  ///////////////////////// slice /////////////////////////////////////////////
+  int slice(LightOccupancy const &occupancy, float dist)
+  {
+    int z = (int)floor(log(dist / occupancy.znear) / log(occupancy.zfar / occupancy.znear) * LightOccupancy::Slices);
+
+    return std::min(std::max(z, 0), LightOccupancy::Slices - 1);
+  }
+
+  ///////////////////////// tile //////////////////////////////////////////////
+  int tile(float ndc, int tiles)
+  {
+    return std::min(std::max((int)floor((0.5f + 0.5f * ndc) * tiles), 0), tiles - 1);
+  }
+
+  ///////////////////////// cluster_range /////////////////////////////////////
+  LightOccupancy::Range cluster_range(LightOccupancy const &occupancy, Vec3 const &lo, Vec3 const &hi)
+  {
+    // conservative cluster range of a view space box
+
+    LightOccupancy::Range range = { 1, 0, 1, 0, 1, 0 };
+
+    float dmin = std::max(-hi.z, occupancy.znear);
+    float dmax = -lo.z;
+
+    if (dmax < occupancy.znear)
+      return range;
+
+    float x0 = occupancy.scalex * std::min(lo.x / dmin, lo.x / dmax);
+    float x1 = occupancy.scalex * std::max(hi.x / dmin, hi.x / dmax);
+    float y0 = occupancy.scaley * std::min(lo.y / dmin, lo.y / dmax);
+    float y1 = occupancy.scaley * std::max(hi.y / dmin, hi.y / dmax);
+
+    if (x1 < -1.0f || x0 > 1.0f || y1 < -1.0f || y0 > 1.0f)
+      return range;
+
+    range.minx = tile(x0, LightOccupancy::TilesX);
+    range.maxx = tile(x1, LightOccupancy::TilesX);
+    range.miny = tile(-y1, LightOccupancy::TilesY);
+    range.maxy = tile(-y0, LightOccupancy::TilesY);
+    range.minz = slice(occupancy, dmin);
+    range.maxz = slice(occupancy, dmax);
+
+    return range;
+  }
+}
+
+
+///////////////////////// prepare_occupancy /////////////////////////////////
+void prepare_occupancy(LightOccupancy &occupancy, Camera const &camera)
+{
+  occupancy.view = camera.transform();
+  occupancy.invview = inverse(camera.transform());
+  occupancy.scalex = 1.0f / (camera.aspect() * tan(0.5f * camera.fov()));
+  occupancy.scaley = 1.0f / tan(0.5f * camera.fov());
+  occupancy.znear = camera.znear();
+  occupancy.zfar = camera.zfar();
+
+  occupancy.occupied.assign(LightOccupancy::ClusterCount, 0);
+
+  occupancy.bound = Bound3(Vec3(std::numeric_limits<float>::max()), Vec3(std::numeric_limits<float>::lowest()));
+}
+
+
+///////////////////////// occupy_clusters ///////////////////////////////////
+void occupy_clusters(LightOccupancy &occupancy, Bound3 const &bound)
+{
+  Vec3 lo(std::numeric_limits<float>::max());
+  Vec3 hi(std::numeric_limits<float>::lowest());
+
+  for(int i = 0; i < 8; ++i)
+  {
+    auto corner = occupancy.invview * Vec3((i & 1) ? bound.max.x : bound.min.x, (i & 2) ? bound.max.y : bound.min.y, (i & 4) ? bound.max.z : bound.min.z);
+
+    lo = lml::min(lo, corner);
+    hi = lml::max(hi, corner);
+  }
+
+  auto range = cluster_range(occupancy, lo, hi);
+
+  if (range.empty())
+    return;
+
+  for(int z = range.minz; z <= range.maxz; ++z)
+    for(int y = range.miny; y <= range.maxy; ++y)
+      for(int x = range.minx; x <= range.maxx; ++x)
+        occupancy.occupied[(z * LightOccupancy::TilesY + y) * LightOccupancy::TilesX + x] = 1;
+
+  occupancy.bound.min = lml::min(occupancy.bound.min, bound.min);
+  occupancy.bound.max = lml::max(occupancy.bound.max, bound.max);
+}
+
+
+///////////////////////// select_lights /////////////////////////////////////
+void select_lights(LightOccupancy &occupancy, Sphere const *lights, size_t count)
+{
+  occupancy.lightranges.resize(count);
+  occupancy.active.assign(count, 0);
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    auto centre = occupancy.invview * lights[i].centre;
+
+    auto &range = occupancy.lightranges[i];
+
+    range = cluster_range(occupancy, centre - Vec3(lights[i].radius), centre + Vec3(lights[i].radius));
+
+    for(int z = range.minz; z <= range.maxz && !occupancy.active[i]; ++z)
+      for(int y = range.miny; y <= range.maxy && !occupancy.active[i]; ++y)
+        for(int x = range.minx; x <= range.maxx && !occupancy.active[i]; ++x)
+          occupancy.active[i] |= occupancy.occupied[(z * LightOccupancy::TilesY + y) * LightOccupancy::TilesX + x];
+  }
+}
+
+
+///////////////////////// select_probes /////////////////////////////////////
+void select_probes(LightOccupancy &occupancy, Bound3 const *probes, size_t count)
+{
+  occupancy.probeactive.assign(count, 0);
+
+  for(size_t probe = 0; probe < count; ++probe)
+  {
+    Vec3 lo(std::numeric_limits<float>::max());
+    Vec3 hi(std::numeric_limits<float>::lowest());
+
+    for(int i = 0; i < 8; ++i)
+    {
+      auto corner = occupancy.invview * Vec3((i & 1) ? probes[probe].max.x : probes[probe].min.x, (i & 2) ? probes[probe].max.y : probes[probe].min.y, (i & 4) ? probes[probe].max.z : probes[probe].min.z);
+
+      lo = lml::min(lo, corner);
+      hi = lml::max(hi, corner);
+    }
+
+    auto range = cluster_range(occupancy, lo, hi);
+
+    for(int z = range.minz; z <= range.maxz && !occupancy.probeactive[probe]; ++z)
+      for(int y = range.miny; y <= range.maxy && !occupancy.probeactive[probe]; ++y)
+        for(int x = range.minx; x <= range.maxx && !occupancy.probeactive[probe]; ++x)
+          occupancy.probeactive[probe] |= occupancy.occupied[(z * LightOccupancy::TilesY + y) * LightOccupancy::TilesX + x];
+  }
+}
+
+
+///////////////////////// build_probegrid ///////////////////////////////////
+void build_probegrid(ProbeGrid &grid, Bound3 const *probes, size_t count, float cellsize)
+{
+  grid.probes.assign(probes, probes + count);
+  grid.cellsize = cellsize;
+
+  grid.bound = Bound3(Vec3(std::numeric_limits<float>::max()), Vec3(std::numeric_limits<float>::lowest()));
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    grid.bound.min = lml::min(grid.bound.min, probes[i].min);
+    grid.bound.max = lml::max(grid.bound.max, probes[i].max);
+  }
+
+  grid.dimx = grid.dimy = grid.dimz = 0;
+
+  if (count != 0)
+  {
+    grid.dimx = std::max((int)ceil((grid.bound.max.x - grid.bound.min.x) / cellsize), 1);
+    grid.dimy = std::max((int)ceil((grid.bound.max.y - grid.bound.min.y) / cellsize), 1);
+    grid.dimz = std::max((int)ceil((grid.bound.max.z - grid.bound.min.z) / cellsize), 1);
+  }
+
+  // counted then scattered, a probe is listed in every cell its box overlaps
+
+  auto cells = [&](Bound3 const &box, int *lo, int *hi) {
+    lo[0] = std::min(std::max((int)floor((box.min.x - grid.bound.min.x) / cellsize), 0), grid.dimx - 1);
+    lo[1] = std::min(std::max((int)floor((box.min.y - grid.bound.min.y) / cellsize), 0), grid.dimy - 1);
+    lo[2] = std::min(std::max((int)floor((box.min.z - grid.bound.min.z) / cellsize), 0), grid.dimz - 1);
+    hi[0] = std::min(std::max((int)floor((box.max.x - grid.bound.min.x) / cellsize), 0), grid.dimx - 1);
+    hi[1] = std::min(std::max((int)floor((box.max.y - grid.bound.min.y) / cellsize), 0), grid.dimy - 1);
+    hi[2] = std::min(std::max((int)floor((box.max.z - grid.bound.min.z) / cellsize), 0), grid.dimz - 1);
+  };
+
+  grid.offsets.assign(grid.dimx * grid.dimy * grid.dimz + 1, 0);
+
+  for(int pass = 0; pass < 2; ++pass)
+  {
+    for(size_t i = 0; i < count; ++i)
+    {
+      int lo[3], hi[3];
+
+      cells(probes[i], lo, hi);
+
+      for(int z = lo[2]; z <= hi[2]; ++z)
+        for(int y = lo[1]; y <= hi[1]; ++y)
+          for(int x = lo[0]; x <= hi[0]; ++x)
+          {
+            int cell = (z * grid.dimy + y) * grid.dimx + x;
+
+            if (pass == 0)
+              grid.offsets[cell + 1] += 1;
+            else
+              grid.indices[grid.offsets[cell]++] = i;
+          }
+    }
+
+    if (pass == 0)
+    {
+      for(size_t cell = 1; cell < grid.offsets.size(); ++cell)
+        grid.offsets[cell] += grid.offsets[cell - 1];
+
+      grid.indices.resize(grid.offsets.back());
+    }
+  }
+
+  // the scatter advanced each offset to the start of the next cell
+
+  for(size_t cell = grid.offsets.size() - 1; cell > 0; --cell)
+    grid.offsets[cell] = grid.offsets[cell - 1];
+
+  grid.offsets[0] = 0;
+
+  grid.stamps.assign(count, 0);
+  grid.stamp = 0;
+}
+
+
+///////////////////////// query_probegrid ///////////////////////////////////
+void query_probegrid(ProbeGrid &grid, Bound3 const &region, vector<size_t> &probes)
+{
+  probes.clear();
+
+  if (grid.probes.empty() || region.min.x > region.max.x)
+    return;
+
+  if (region.max.x < grid.bound.min.x || region.max.y < grid.bound.min.y || region.max.z < grid.bound.min.z)
+    return;
+
+  if (region.min.x > grid.bound.max.x || region.min.y > grid.bound.max.y || region.min.z > grid.bound.max.z)
+    return;
+
+  int x0 = std::max((int)floor((region.min.x - grid.bound.min.x) / grid.cellsize), 0);
+  int y0 = std::max((int)floor((region.min.y - grid.bound.min.y) / grid.cellsize), 0);
+  int z0 = std::max((int)floor((region.min.z - grid.bound.min.z) / grid.cellsize), 0);
+  int x1 = std::min((int)floor((region.max.x - grid.bound.min.x) / grid.cellsize), grid.dimx - 1);
+  int y1 = std::min((int)floor((region.max.y - grid.bound.min.y) / grid.cellsize), grid.dimy - 1);
+  int z1 = std::min((int)floor((region.max.z - grid.bound.min.z) / grid.cellsize), grid.dimz - 1);
+
+  if (++grid.stamp == 0)
+  {
+    grid.stamps.assign(grid.stamps.size(), 0);
+    grid.stamp = 1;
+  }
+
+  for(int z = z0; z <= z1; ++z)
+    for(int y = y0; y <= y1; ++y)
+      for(int x = x0; x <= x1; ++x)
+      {
+        int cell = (z * grid.dimy + y) * grid.dimx + x;
+
+        for(uint32_t k = grid.offsets[cell]; k < grid.offsets[cell + 1]; ++k)
+        {
+          auto i = grid.indices[k];
+
+          if (grid.stamps[i] == grid.stamp)
+            continue;
+
+          grid.stamps[i] = grid.stamp;
+
+          auto &box = grid.probes[i];
+
+          if (box.max.x < region.min.x || box.max.y < region.min.y || box.max.z < region.min.z)
+            continue;
+
+          if (box.min.x > region.max.x || box.min.y > region.max.y || box.min.z > region.max.z)
+            continue;
+
+          probes.push_back(i);
+        }
+      }
+}
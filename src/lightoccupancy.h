@@ -0,0 +1,102 @@
+//
+// lightoccupancy.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/renderer.h"
+#include <vector>
+
+//|---------------------- LightOccupancy ------------------------------------
+//|--------------------------------------------------------------------------
+
+struct LightOccupancy
+{
+  enum { TilesX = 16, TilesY = 9, Slices = 24 };
+  enum { ClusterCount = TilesX * TilesY * Slices };
+
+  // view, slices are exponential from znear to zfar
+
+  lml::Transform view;
+  lml::Transform invview;
+
+  float scalex, scaley;
+  float znear, zfar;
+
+  struct Range
+  {
+    int minx, maxx;
+    int miny, maxy;
+    int minz, maxz;
+
+    bool empty() const { return minx > maxx; }
+  };
+
+  // per cluster, touched by visible geometry, and the world bound of that
+  // geometry
+
+  std::vector<uint8_t> occupied;
+
+  lml::Bound3 bound;
+
+  // per light, cluster range and whether it reaches an occupied cluster
+
+  std::vector<Range> lightranges;
+  std::vector<uint8_t> active;
+
+  // per probe, whether its box reaches an occupied cluster
+
+  std::vector<uint8_t> probeactive;
+};
+
+// occupancy culling, lights and probes that reach no view cluster holding
+// visible geometry cannot light a visible pixel, clusters span the camera
+// frustum from znear to zfar
+
+void prepare_occupancy(LightOccupancy &occupancy, Camera const &camera);
+
+void occupy_clusters(LightOccupancy &occupancy, lml::Bound3 const &bound);
+
+// cluster range of each light and whether it reaches an occupied cluster
+
+void select_lights(LightOccupancy &occupancy, lml::Sphere const *lights, size_t count);
+
+// whether each probe box reaches an occupied cluster, probes that do not
+// cannot contribute to any visible pixel
+
+void select_probes(LightOccupancy &occupancy, lml::Bound3 const *probes, size_t count);
+
+
+//|---------------------- ProbeGrid -----------------------------------------
+//|--------------------------------------------------------------------------
+
+// uniform grid over static probe boxes, so finding the probes near a region
+// costs the probes in the cells it overlaps rather than every probe
+
+struct ProbeGrid
+{
+  lml::Bound3 bound;
+
+  float cellsize;
+  int dimx, dimy, dimz;
+
+  std::vector<lml::Bound3> probes;
+
+  // per cell, range into indices (offsets has a trailing entry)
+
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> indices;
+
+  // scratch, probe last returned by query, so overlapping cells dedup
+
+  std::vector<uint32_t> stamps;
+  uint32_t stamp = 0;
+};
+
+void build_probegrid(ProbeGrid &grid, lml::Bound3 const *probes, size_t count, float cellsize);
+
+// probes whose box overlaps the region, each once
+
+void query_probegrid(ProbeGrid &grid, lml::Bound3 const &region, std::vector<size_t> &probes);
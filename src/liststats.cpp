@@ -0,0 +1,83 @@
+//
+// liststats.cpp
+//
+
+#include "liststats.h"
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+  const char *listnames[ListStats::ListCount] = { "geometry", "casters", "forward", "lights" };
+}
+
+
+///////////////////////// clear_liststats ///////////////////////////////////
+void clear_liststats(ListStats &stats)
+{
+  for(auto &counters : stats.lists)
+  {
+    counters = {};
+  }
+}
+
+
+///////////////////////// start_liststats ///////////////////////////////////
+void start_liststats(ListStats &stats, const char *path)
+{
+  stats.csv.open(path, ios::trunc);
+
+  if (!stats.csv)
+  {
+    cout << "List Stats: unable to open " << path << endl;
+    return;
+  }
+
+  stats.frame = 0;
+
+  stats.csv << "frame,listtime";
+
+  for(auto &name : listnames)
+  {
+    stats.csv << ',' << name << "_nodesvisited";
+    stats.csv << ',' << name << "_nodesinside";
+    stats.csv << ',' << name << "_nodesrejected";
+    stats.csv << ',' << name << "_itemstested";
+    stats.csv << ',' << name << "_itemspushed";
+    stats.csv << ',' << name << "_notready";
+  }
+
+  stats.csv << '\n';
+}
+
+
+///////////////////////// stop_liststats ////////////////////////////////////
+void stop_liststats(ListStats &stats)
+{
+  stats.csv.close();
+}
+
+
+///////////////////////// record_liststats //////////////////////////////////
+void record_liststats(ListStats &stats, float listtime)
+{
+  if (!stats.csv.is_open())
+    return;
+
+  stats.csv << stats.frame << ',' << listtime;
+
+  for(auto &counters : stats.lists)
+  {
+    stats.csv << ',' << counters.nodesvisited;
+    stats.csv << ',' << counters.nodesinside;
+    stats.csv << ',' << counters.nodesrejected;
+    stats.csv << ',' << counters.itemstested;
+    stats.csv << ',' << counters.itemspushed;
+    stats.csv << ',' << counters.notready;
+  }
+
+  stats.csv << '\n';
+
+  stats.frame += 1;
+}
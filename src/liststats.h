@@ -0,0 +1,43 @@
+//
+// liststats.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include <fstream>
+
+//|---------------------- ListStats -----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct ListStats
+{
+  enum { Geometry, Casters, Forward, Lights, ListCount };
+
+  struct Counters
+  {
+    size_t nodesvisited;    // tree nodes classified for the list view
+    size_t nodesinside;     // fully contained
+    size_t nodesrejected;   // outside or occluded
+    size_t itemstested;     // items tested individually
+    size_t itemspushed;     // draws (or lights) pushed to the list
+    size_t notready;        // items skipped for a resource still loading
+  };
+
+  Counters lists[ListCount] = {};
+
+  // csv time series, a row per frame while recording
+
+  std::ofstream csv;
+
+  size_t frame = 0;
+};
+
+void clear_liststats(ListStats &stats);
+
+void start_liststats(ListStats &stats, const char *path);
+void stop_liststats(ListStats &stats);
+
+// appends the frame counters and list build time (ms) when recording
+
+void record_liststats(ListStats &stats, float listtime);
@@ -0,0 +1,267 @@
+//
+// Datum - mesh lod generator
+//
+
+#include "toolplatform.h"
+#include "assetrequest.h"
+#include "datum/asset.h"
+#include "datum/renderer.h"
+#include "datum/scene.h"
+#include "assetpacker.h"
+#include <leap.h>
+#include <leap/pathstring.h>
+#include <unordered_map>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace lml;
+using namespace leap;
+using namespace DatumPlatform;
+
+//|---------------------- Simplify ------------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// simplify //////////////////////////////////////////
+void simplify(vector<PackVertex> const &vertices, vector<uint32_t> const &indices, float cellsize, vector<PackVertex> &lodvertices, vector<uint32_t> &lodindices)
+{
+  // vertex clustering, vertices sharing a grid cell collapse onto their
+  // average position and the degenerate triangles drop out
+
+  struct Cell
+  {
+    uint32_t vertex;
+    uint32_t count;
+    Vec3 sum;
+  };
+
+  unordered_map<uint64_t, Cell> cells;
+
+  vector<uint32_t> remap(vertices.size());
+
+  lodvertices.clear();
+  lodindices.clear();
+
+  for(size_t i = 0; i < vertices.size(); ++i)
+  {
+    auto position = Vec3(vertices[i].position[0], vertices[i].position[1], vertices[i].position[2]);
+
+    uint64_t x = (uint64_t)(int64_t)floor(position.x / cellsize) & 0x1FFFFF;
+    uint64_t y = (uint64_t)(int64_t)floor(position.y / cellsize) & 0x1FFFFF;
+    uint64_t z = (uint64_t)(int64_t)floor(position.z / cellsize) & 0x1FFFFF;
+
+    auto &cell = cells[(x << 42) | (y << 21) | z];
+
+    if (cell.count == 0)
+    {
+      cell.vertex = lodvertices.size();
+      cell.sum = Vec3(0.0f);
+
+      lodvertices.push_back(vertices[i]);
+    }
+
+    cell.count += 1;
+    cell.sum += position;
+
+    remap[i] = cell.vertex;
+  }
+
+  for(auto &entry : cells)
+  {
+    auto &cell = entry.second;
+
+    auto position = cell.sum / (float)cell.count;
+
+    lodvertices[cell.vertex].position[0] = position.x;
+    lodvertices[cell.vertex].position[1] = position.y;
+    lodvertices[cell.vertex].position[2] = position.z;
+  }
+
+  for(size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    auto a = remap[indices[i+0]];
+    auto b = remap[indices[i+1]];
+    auto c = remap[indices[i+2]];
+
+    if (a == b || b == c || c == a)
+      continue;
+
+    lodindices.push_back(a);
+    lodindices.push_back(b);
+    lodindices.push_back(c);
+  }
+}
+
+
+///////////////////////// checksum //////////////////////////////////////////
+uint64_t checksum(PackVertex const *vertices, size_t vertexcount, uint32_t const *indices, size_t indexcount)
+{
+  // fnv-1a over the positions and indices
+
+  uint64_t hash = 14695981039346656037ull;
+
+  auto append = [&](void const *data, size_t bytes) {
+    for(size_t i = 0; i < bytes; ++i)
+      hash = (hash ^ static_cast<uint8_t const *>(data)[i]) * 1099511628211ull;
+  };
+
+  for(size_t i = 0; i < vertexcount; ++i)
+    append(vertices[i].position, sizeof(vertices[i].position));
+
+  append(indices, indexcount * sizeof(uint32_t));
+
+  return hash;
+}
+
+
+///////////////////////// main //////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  cout << "Mesh LOD Generator" << endl;
+
+  try
+  {
+    ToolPlatform platform;
+
+    initialise_platform(platform, 256*1024*1024);
+
+    AssetManager assets(platform.gamememory);
+
+    initialise_asset_system(platform, assets, 64*1024, 128*1024*1024);
+
+    ResourceManager resources(assets, platform.gamememory);
+
+    Scene scene(platform.gamememory);
+
+    scene.initialise_component_storage<TransformComponent>();
+    scene.initialise_component_storage<MeshComponent>();
+    scene.initialise_component_storage<PointLightComponent>();
+
+    auto model = scene.load<Model>(platform, &resources, assets.load(platform, "sponza.pack"));
+
+    cout << "Generating..." << endl;
+
+    ofstream fout("sponza-lod.pack", ios::binary | ios::trunc);
+
+    write_header(fout);
+
+    // three coarser levels per model mesh, in model mesh order, cells are a
+    // fraction of the mesh bound diagonal
+
+    const float cellfractions[] = { 1.0f / 64.0f, 1.0f / 32.0f, 1.0f / 16.0f };
+
+    uint32_t id = 0;
+
+    size_t triangles[extentof(cellfractions) + 1] = {};
+
+    // what each written asset should read back as
+
+    struct Written
+    {
+      uint32_t vertexcount;
+      uint32_t indexcount;
+      uint64_t checksum;
+    };
+
+    vector<Written> written;
+
+    for(auto &mesh : scene.get<Model>(model)->meshes)
+    {
+      asset_guard lock(assets);
+
+      auto bits = mesh ? wait_asset(platform, assets, mesh->asset) : nullptr;
+
+      if (!bits)
+      {
+        throw runtime_error("Model Mesh Load Failure");
+      }
+
+      auto asset = mesh->asset;
+
+      auto payloadvertices = reinterpret_cast<PackVertex const *>(bits);
+      auto payloadindices = reinterpret_cast<uint32_t const *>(payloadvertices + asset->vertexcount);
+
+      vector<PackVertex> vertices(payloadvertices, payloadvertices + asset->vertexcount);
+      vector<uint32_t> indices(payloadindices, payloadindices + asset->indexcount);
+
+      Bound3 bound = mesh->bound;
+
+      triangles[0] += indices.size() / 3;
+
+      vector<PackVertex> lodvertices = vertices;
+      vector<uint32_t> lodindices = indices;
+
+      vector<PackVertex> simplevertices;
+      vector<uint32_t> simpleindices;
+
+      for(size_t level = 0; level < extentof(cellfractions); ++level)
+      {
+        simplify(vertices, indices, std::max(cellfractions[level] * norm(bound.max - bound.min), 1e-5f), simplevertices, simpleindices);
+
+        // fully collapsed meshes keep the previous level
+
+        if (!simpleindices.empty())
+        {
+          swap(lodvertices, simplevertices);
+          swap(lodindices, simpleindices);
+        }
+
+        triangles[level + 1] += lodindices.size() / 3;
+
+        write_mesh_asset(fout, id++, lodvertices, lodindices, bound);
+
+        written.push_back({ (uint32_t)lodvertices.size(), (uint32_t)lodindices.size(), checksum(lodvertices.data(), lodvertices.size(), lodindices.data(), lodindices.size()) });
+      }
+    }
+
+    write_chunk(fout, "HEND", 0, nullptr);
+
+    fout.close();
+
+    // read the pack back through the asset manager with the payload layout
+    // the meshes were read with (vertices then indices), so a layout or
+    // ordering mismatch fails here rather than in the game
+
+    cout << "Verifying..." << endl;
+
+    auto lodpack = assets.load(platform, "sponza-lod.pack");
+
+    if (!lodpack)
+      throw runtime_error("Verify Error: unable to load sponza-lod.pack");
+
+    for(uint32_t i = 0; i < written.size(); ++i)
+    {
+      auto asset = assets.find(lodpack->id + i);
+
+      if (!asset || asset->vertexcount != written[i].vertexcount || asset->indexcount != written[i].indexcount)
+        throw runtime_error("Verify Error: asset " + to_string(i) + " header mismatch");
+
+      asset_guard lock(assets);
+
+      auto bits = wait_asset(platform, assets, asset);
+
+      if (!bits)
+        throw runtime_error("Verify Error: asset " + to_string(i) + " read failure");
+
+      auto payloadvertices = reinterpret_cast<PackVertex const *>(bits);
+      auto payloadindices = reinterpret_cast<uint32_t const *>(payloadvertices + asset->vertexcount);
+
+      if (checksum(payloadvertices, asset->vertexcount, payloadindices, asset->indexcount) != written[i].checksum)
+        throw runtime_error("Verify Error: asset " + to_string(i) + " payload mismatch");
+    }
+
+    cout << "  " << written.size() << " meshes verified" << endl;
+
+    for(size_t level = 0; level < extentof(triangles); ++level)
+    {
+      cout << "  Level " << level << ": " << triangles[level] << " triangles" << endl;
+    }
+  }
+  catch(exception &e)
+  {
+    cerr << "Critical Error:" << e.what() << endl;
+  }
+}
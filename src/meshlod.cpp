@@ -0,0 +1,172 @@
+//
+// meshlod.cpp
+//
+
+#include "meshlod.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace lml;
+
+namespace
+{
+  ///////////////////////// select_level //////////////////////////////////////
+  int select_level(MeshLod const &lod, int level, float size)
+  {
+    // a level holds until the size leaves its band by the hysteresis margin
+
+    while (level > 0 && size > lod.thresholds[level - 1] * (1.0f + lod.hysteresis))
+      --level;
+
+    while (level < MeshLod::Levels - 1 && size < lod.thresholds[level] * (1.0f - lod.hysteresis))
+      ++level;
+
+    return level;
+  }
+
+  ///////////////////////// projected_size ////////////////////////////////////
+  float projected_size(Camera const &camera, Bound3 const &bound)
+  {
+    float radius = 0.5f * norm(bound.max - bound.min);
+    float distance = std::max(dist(bound.centre(), camera.position()), radius);
+
+    return radius / distance / tan(0.5f * camera.fov());
+  }
+}
+
+
+///////////////////////// load_meshlod //////////////////////////////////////
+bool load_meshlod(MeshLod &lod, AssetManager &assets, ResourceManager &resources, Model const *model, Asset const *pack)
+{
+  lod.meshes.clear();
+  lod.meshlevels.clear();
+
+  // the pack must hold every level of every model mesh, each no larger than
+  // the mesh it reduces, or it is from another model and goes unused
+
+  bool valid = (pack != nullptr);
+
+  for(size_t i = 0; i < model->meshes.size() && valid; ++i)
+  {
+    for(int level = 1; level < MeshLod::Levels && valid; ++level)
+    {
+      auto asset = assets.find(pack->id + i * (MeshLod::Levels - 1) + level - 1);
+
+      valid = asset && asset->vertexcount <= model->meshes[i]->asset->vertexcount && asset->indexcount <= model->meshes[i]->asset->indexcount;
+    }
+  }
+
+  for(size_t i = 0; i < model->meshes.size(); ++i)
+  {
+    auto &levels = lod.meshes[model->meshes[i]];
+
+    levels[0] = model->meshes[i];
+
+    for(int level = 1; level < MeshLod::Levels; ++level)
+    {
+      auto asset = valid ? assets.find(pack->id + i * (MeshLod::Levels - 1) + level - 1) : nullptr;
+
+      levels[level] = asset ? resources.create<Mesh>(asset) : levels[level - 1];
+    }
+  }
+
+  return valid;
+}
+
+
+///////////////////////// select_meshlod ////////////////////////////////////
+void select_meshlod(MeshLod &lod, Camera const &camera, Visibility const &visibility, int view)
+{
+  auto &visible = visibility.visible;
+
+  if (lod.meshlevels.size() != visibility.resourceids.size())
+  {
+    lod.meshlevels.assign(visibility.resourceids.size(), {});
+
+    for(auto &id : visibility.resourceids)
+    {
+      auto levels = lod.meshes.find(static_cast<Mesh const *>(id.first));
+
+      if (levels != lod.meshes.end())
+        lod.meshlevels[id.second] = levels->second;
+    }
+  }
+
+  if (lod.staticlevels.size() != visibility.items.size())
+  {
+    lod.staticlevels.assign(visibility.items.size(), 0);
+  }
+
+  if (lod.dynamiclevels.size() < visibility.dynamicitems.size())
+  {
+    lod.dynamiclevels.resize(visibility.dynamicitems.size(), {});
+  }
+
+  lod.geometrylevels.resize(visible.size());
+  lod.casterlevels.resize(visible.size());
+
+  lod.reduced = 0;
+
+  for(size_t i = 0; i < visible.size(); ++i)
+  {
+    auto item = visible[i].item;
+
+    float size = projected_size(camera, item->bound);
+
+    // camera levels persist, shadow only items pick afresh each frame
+
+    uint8_t *previous = nullptr;
+
+    if (item >= visibility.items.data() && item < visibility.items.data() + visibility.items.size())
+    {
+      previous = &lod.staticlevels[item - visibility.items.data()];
+    }
+    else
+    {
+      auto &slot = lod.dynamiclevels[item - visibility.dynamicitems.data()];
+
+      if (slot.entity != item->entity)
+        slot = { item->entity, 0 };
+
+      previous = &slot.level;
+    }
+
+    int level = select_level(lod, *previous, size);
+
+    lod.geometrylevels[i] = std::min(level + lod.bias, MeshLod::Levels - 1);
+    lod.casterlevels[i] = std::min(level + lod.bias + lod.casterbias, MeshLod::Levels - 1);
+
+    if (visible[i].views & (1 << view))
+    {
+      *previous = level;
+
+      if (lod_mesh(lod, item, lod.geometrylevels[i]) != item->mesh)
+        lod.reduced += 1;
+    }
+  }
+}
+
+
+///////////////////////// caster_level //////////////////////////////////////
+int caster_level(MeshLod const &lod, Camera const &camera, Visibility const &visibility, size_t index)
+{
+  // as select_meshlod picks for a shadow only item, from the camera level
+  // the item last held
+
+  int previous = (index < lod.staticlevels.size()) ? lod.staticlevels[index] : 0;
+
+  int level = select_level(lod, previous, projected_size(camera, visibility.items[index].bound));
+
+  return std::min(level + lod.bias + lod.casterbias, MeshLod::Levels - 1);
+}
+
+
+///////////////////////// lod_mesh //////////////////////////////////////////
+Mesh const *lod_mesh(MeshLod const &lod, Visibility::Item const *item, int level)
+{
+  if (level == 0 || item->meshid >= lod.meshlevels.size() || !lod.meshlevels[item->meshid][0])
+    return item->mesh;
+
+  return lod.meshlevels[item->meshid][level];
+}
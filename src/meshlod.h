@@ -0,0 +1,77 @@
+//
+// meshlod.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/scene.h"
+#include "datum/renderer.h"
+#include "visibility.h"
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+//|---------------------- MeshLod -------------------------------------------
+//|--------------------------------------------------------------------------
+
+struct MeshLod
+{
+  enum { Levels = 4 };
+
+  // level 0 is the model mesh, coarser levels fall back to the next finer
+  // when the lod pack has none
+
+  std::unordered_map<Mesh const *, std::array<Mesh const *, Levels>> meshes;
+
+  // the same levels by dense mesh id (Visibility::Item::meshid), refreshed
+  // as the visibility hands out ids, empty entries are not lod meshes
+
+  std::vector<std::array<Mesh const *, Levels>> meshlevels;
+
+  // current camera level per static item, and per dynamic item slot with
+  // the entity it was chosen for, for hysteresis
+
+  struct DynamicLevel
+  {
+    Scene::EntityId entity;
+    uint8_t level;
+  };
+
+  std::vector<uint8_t> staticlevels;
+  std::vector<DynamicLevel> dynamiclevels;
+
+  float thresholds[Levels - 1] = { 0.08f, 0.04f, 0.02f };   // projected radius, fraction of the view height
+  float hysteresis = 0.15f;                                 // relative band around each threshold
+
+  int bias = 0;             // added to every level
+  int casterbias = 1;       // added to shadow caster levels
+
+  // per visible item, chosen level for the camera and sun views
+
+  std::vector<uint8_t> geometrylevels;
+  std::vector<uint8_t> casterlevels;
+
+  // stats
+
+  int reduced = 0;
+};
+
+// binds the meshes of the lod pack, generated by lodgen from the model pack
+// as Levels - 1 meshes per model mesh, pack may be null, false when there is
+// no pack matching the model and the model meshes stand in for every level
+
+bool load_meshlod(MeshLod &lod, AssetManager &assets, ResourceManager &resources, Model const *model, Asset const *pack);
+
+// picks the levels of the visible items from their projected size, view is
+// the camera bit of the visible view masks
+
+void select_meshlod(MeshLod &lod, Camera const &camera, Visibility const &visibility, int view);
+
+// caster level of a static item (index into the visibility items) that is
+// not in the visible set, the level select_meshlod would give it
+
+int caster_level(MeshLod const &lod, Camera const &camera, Visibility const &visibility, size_t index);
+
+Mesh const *lod_mesh(MeshLod const &lod, Visibility::Item const *item, int level);
@@ -0,0 +1,447 @@
+//
+// occlusion.cpp
+//
+
+#include "occlusion.h"
+#include "assetrequest.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace lml;
+using namespace DatumPlatform;
+
+namespace
+{
+  const float Empty = std::numeric_limits<float>::lowest();
+
+  // bounds are tested grown by this much, so a surface is not hidden by
+  // its own occluder triangles at equal depth
+
+  const float Margin = 0.05f;
+
+  struct Projected
+  {
+    float x, y, key;
+  };
+
+  ///////////////////////// project ///////////////////////////////////////////
+  Projected project(Occlusion const &occlusion, Vec3 const &v)
+  {
+    float dist = -v.z;
+
+    Projected result;
+
+    if (occlusion.view.orthographic)
+    {
+      result.x = occlusion.view.scalex * v.x + occlusion.view.offsetx;
+      result.y = occlusion.view.scaley * v.y + occlusion.view.offsety;
+      result.key = -dist;
+    }
+    else
+    {
+      result.x = occlusion.view.scalex * v.x / dist + occlusion.view.offsetx;
+      result.y = occlusion.view.scaley * v.y / dist + occlusion.view.offsety;
+      result.key = 1.0f / dist;
+    }
+
+    result.x = (0.5f + 0.5f * result.x) * occlusion.width;
+    result.y = (0.5f - 0.5f * result.y) * occlusion.height;
+
+    return result;
+  }
+
+  ///////////////////////// setup_triangle ////////////////////////////////////
+  void setup_triangle(Occlusion &occlusion, Projected p0, Projected p1, Projected p2)
+  {
+    float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+
+    if (std::abs(area) < 1e-6f)
+      return;
+
+    if (area < 0.0f)
+    {
+      swap(p1, p2);
+      area = -area;
+    }
+
+    Occlusion::Triangle triangle;
+
+    triangle.minx = std::max(0, (int)floor(std::min({ p0.x, p1.x, p2.x })));
+    triangle.miny = std::max(0, (int)floor(std::min({ p0.y, p1.y, p2.y })));
+    triangle.maxx = std::min(occlusion.width - 1, (int)ceil(std::max({ p0.x, p1.x, p2.x })));
+    triangle.maxy = std::min(occlusion.height - 1, (int)ceil(std::max({ p0.y, p1.y, p2.y })));
+
+    if (triangle.minx > triangle.maxx || triangle.miny > triangle.maxy)
+      return;
+
+    Projected const *p[3] = { &p0, &p1, &p2 };
+
+    // inner conservative, the edges are pulled in by half a pixel so a
+    // centre passes only when the triangle covers the whole pixel, and the
+    // depth plane is pushed back to the farthest key over the pixel
+
+    for(int i = 0; i < 3; ++i)
+    {
+      auto &a = *p[i];
+      auto &b = *p[(i + 1) % 3];
+
+      triangle.a[i] = a.y - b.y;
+      triangle.b[i] = b.x - a.x;
+      triangle.c[i] = (b.y - a.y) * a.x - (b.x - a.x) * a.y - 0.5f * (std::abs(triangle.a[i]) + std::abs(triangle.b[i]));
+    }
+
+    triangle.zx = ((p1.key - p0.key) * (p2.y - p0.y) - (p2.key - p0.key) * (p1.y - p0.y)) / area;
+    triangle.zy = ((p2.key - p0.key) * (p1.x - p0.x) - (p1.key - p0.key) * (p2.x - p0.x)) / area;
+    triangle.z0 = p0.key - triangle.zx * p0.x - triangle.zy * p0.y - 0.5f * (std::abs(triangle.zx) + std::abs(triangle.zy));
+
+    occlusion.triangles.push_back(triangle);
+  }
+
+  ///////////////////////// setup_occlusion ///////////////////////////////////
+  void setup_occlusion(Occlusion &occlusion, OcclusionView const &view, vector<Vec3> const &occluders)
+  {
+    occlusion.view = view;
+    occlusion.triangles.clear();
+
+    for(size_t i = 0; i + 2 < occluders.size(); i += 3)
+    {
+      Vec3 v[3] = { view.invview * occluders[i], view.invview * occluders[i+1], view.invview * occluders[i+2] };
+
+      // clip to the near plane, leaves at most a quad
+
+      Vec3 polygon[4];
+      int n = 0;
+
+      for(int k = 0; k < 3; ++k)
+      {
+        auto &a = v[k];
+        auto &b = v[(k + 1) % 3];
+
+        float da = -a.z - view.znear;
+        float db = -b.z - view.znear;
+
+        if (da >= 0.0f)
+          polygon[n++] = a;
+
+        if ((da >= 0.0f) != (db >= 0.0f))
+          polygon[n++] = a + (da / (da - db)) * (b - a);
+      }
+
+      for(int k = 2; k < n; ++k)
+      {
+        setup_triangle(occlusion, project(occlusion, polygon[0]), project(occlusion, polygon[k-1]), project(occlusion, polygon[k]));
+      }
+    }
+
+    occlusion.active = !occluders.empty();
+  }
+
+  ///////////////////////// rasterise_band ////////////////////////////////////
+  void rasterise_band(Occlusion &occlusion, int band, int bands)
+  {
+    int y0 = band * occlusion.height / bands;
+    int y1 = (band + 1) * occlusion.height / bands;
+
+    std::fill(occlusion.depth.begin() + y0 * occlusion.width, occlusion.depth.begin() + y1 * occlusion.width, Empty);
+
+    for(auto &triangle : occlusion.triangles)
+    {
+      int miny = std::max(triangle.miny, y0);
+      int maxy = std::min(triangle.maxy, y1 - 1);
+
+      int minx = triangle.minx & ~3;
+      int maxx = triangle.maxx;
+
+      for(int y = miny; y <= maxy; ++y)
+      {
+        float py = y + 0.5f;
+
+        float *row = occlusion.depth.data() + y * occlusion.width;
+
+#if OCCLUSION_SSE
+
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 e0 = _mm_set1_ps(triangle.b[0] * py + triangle.c[0]);
+        __m128 e1 = _mm_set1_ps(triangle.b[1] * py + triangle.c[1]);
+        __m128 e2 = _mm_set1_ps(triangle.b[2] * py + triangle.c[2]);
+        __m128 z = _mm_set1_ps(triangle.zy * py + triangle.z0);
+
+        __m128 a0 = _mm_set1_ps(triangle.a[0]);
+        __m128 a1 = _mm_set1_ps(triangle.a[1]);
+        __m128 a2 = _mm_set1_ps(triangle.a[2]);
+        __m128 zx = _mm_set1_ps(triangle.zx);
+
+        for(int x = minx; x <= maxx; x += 4)
+        {
+          __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+
+          __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, px), e0);
+          __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, px), e1);
+          __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, px), e2);
+
+          __m128 inside = _mm_cmpge_ps(_mm_min_ps(_mm_min_ps(w0, w1), w2), zero);
+
+          if (_mm_movemask_ps(inside) == 0)
+            continue;
+
+          __m128 key = _mm_add_ps(_mm_mul_ps(zx, px), z);
+
+          __m128 depth = _mm_loadu_ps(row + x);
+
+          depth = _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(depth, key)), _mm_andnot_ps(inside, depth));
+
+          _mm_storeu_ps(row + x, depth);
+        }
+
+#else
+
+        for(int x = minx; x <= maxx; ++x)
+        {
+          float px = x + 0.5f;
+
+          float w0 = triangle.a[0] * px + triangle.b[0] * py + triangle.c[0];
+          float w1 = triangle.a[1] * px + triangle.b[1] * py + triangle.c[1];
+          float w2 = triangle.a[2] * px + triangle.b[2] * py + triangle.c[2];
+
+          if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+          {
+            row[x] = std::max(row[x], triangle.zx * px + triangle.zy * py + triangle.z0);
+          }
+        }
+
+#endif
+      }
+    }
+  }
+
+  struct RasterTask
+  {
+    Occlusion *occlusion;
+
+    int count;
+    int bands;
+
+    std::atomic<int> next;
+
+    // jobs still running, the caller blocks on done rather than spinning
+
+    int pending;
+    std::mutex lock;
+    std::condition_variable done;
+  };
+
+  ///////////////////////// rasterise_bands ///////////////////////////////////
+  void rasterise_bands(RasterTask &task)
+  {
+    for(int i = task.next.fetch_add(1); i < task.count * task.bands; i = task.next.fetch_add(1))
+    {
+      rasterise_band(task.occlusion[i / task.bands], i % task.bands, task.bands);
+    }
+  }
+
+  ///////////////////////// raster_job ////////////////////////////////////////
+  void raster_job(PlatformInterface &platform, void *ldata, void *rdata)
+  {
+    RasterTask &task = *static_cast<RasterTask*>(ldata);
+
+    rasterise_bands(task);
+
+    std::lock_guard<std::mutex> lock(task.lock);
+
+    task.pending -= 1;
+
+    task.done.notify_all();
+  }
+}
+
+
+///////////////////////// occlusion_perspective /////////////////////////////
+OcclusionView occlusion_perspective(Transform const &view, float fov, float aspect, float znear)
+{
+  OcclusionView result;
+
+  result.invview = inverse(view);
+  result.orthographic = false;
+  result.scalex = 1.0f / (aspect * tan(0.5f * fov));
+  result.scaley = 1.0f / tan(0.5f * fov);
+  result.offsetx = 0.0f;
+  result.offsety = 0.0f;
+  result.znear = znear;
+
+  return result;
+}
+
+
+///////////////////////// occlusion_orthographic ////////////////////////////
+OcclusionView occlusion_orthographic(Transform const &view, float left, float bottom, float right, float top, float znear)
+{
+  OcclusionView result;
+
+  result.invview = inverse(view);
+  result.orthographic = true;
+  result.scalex = 2.0f / (right - left);
+  result.scaley = 2.0f / (top - bottom);
+  result.offsetx = -(right + left) / (right - left);
+  result.offsety = -(top + bottom) / (top - bottom);
+  result.znear = znear;
+
+  return result;
+}
+
+
+///////////////////////// load_occluders ////////////////////////////////////
+void load_occluders(PlatformInterface &platform, AssetManager &assets, Asset const *asset, vector<Vec3> &occluders)
+{
+  if (!asset)
+    throw runtime_error("Occluder Asset Missing");
+
+  asset_guard lock(assets);
+
+  auto bits = wait_asset(platform, assets, asset);
+
+  if (!bits)
+    throw runtime_error("Occluder Asset Read Failure");
+
+  auto payload = static_cast<uint32_t const *>(bits);
+
+  size_t payloadwords = (size_t)asset->width * asset->height;
+
+  if (payloadwords < 1 || payload[0] % 3 != 0 || payloadwords < 1 + 3 * (size_t)payload[0])
+    throw runtime_error("Occluder Payload Error");
+
+  auto vertices = reinterpret_cast<float const *>(payload + 1);
+
+  for(uint32_t i = 0; i < payload[0]; ++i)
+  {
+    occluders.push_back(Vec3(vertices[3*i+0], vertices[3*i+1], vertices[3*i+2]));
+  }
+}
+
+
+///////////////////////// initialise_occlusion //////////////////////////////
+void initialise_occlusion(Occlusion &occlusion, int width, int height)
+{
+  assert(width % 4 == 0);
+
+  occlusion.width = width;
+  occlusion.height = height;
+  occlusion.depth.assign(width * height, Empty);
+  occlusion.active = false;
+}
+
+
+///////////////////////// rasterise_occlusion ///////////////////////////////
+void rasterise_occlusion(PlatformInterface &platform, Occlusion *occlusion, OcclusionView const *views, int count, vector<Vec3> const &occluders, bool parallel)
+{
+  for(int i = 0; i < count; ++i)
+  {
+    setup_occlusion(occlusion[i], views[i], occluders);
+  }
+
+  const int jobs = 3;
+
+  RasterTask task;
+  task.occlusion = occlusion;
+  task.count = count;
+  task.bands = 8;
+  task.next = 0;
+  task.pending = 0;
+
+  if (parallel)
+  {
+    task.pending = jobs;
+
+    for(int i = 0; i < jobs; ++i)
+    {
+      platform.submit_work(raster_job, &task, nullptr);
+    }
+  }
+
+  rasterise_bands(task);
+
+  std::unique_lock<std::mutex> lock(task.lock);
+
+  task.done.wait(lock, [&]() { return task.pending == 0; });
+}
+
+
+///////////////////////// occluded //////////////////////////////////////////
+bool occluded(Occlusion const &occlusion, Bound3 const &bound)
+{
+  // the bound is occluded when its nearest depth is behind the key of every
+  // pixel its screen rectangle touches, a key is only written where one
+  // triangle covers the whole pixel, so a gap between occluders never
+  // hides what is behind it
+
+  if (!occlusion.active)
+    return false;
+
+  float minx = std::numeric_limits<float>::max();
+  float miny = std::numeric_limits<float>::max();
+  float maxx = std::numeric_limits<float>::lowest();
+  float maxy = std::numeric_limits<float>::lowest();
+  float nearest = std::numeric_limits<float>::lowest();
+
+  for(int i = 0; i < 8; ++i)
+  {
+    auto corner = occlusion.view.invview * Vec3((i & 1) ? bound.max.x + Margin : bound.min.x - Margin, (i & 2) ? bound.max.y + Margin : bound.min.y - Margin, (i & 4) ? bound.max.z + Margin : bound.min.z - Margin);
+
+    if (-corner.z < occlusion.view.znear)
+      return false;
+
+    auto p = project(occlusion, corner);
+
+    minx = std::min(minx, p.x);
+    miny = std::min(miny, p.y);
+    maxx = std::max(maxx, p.x);
+    maxy = std::max(maxy, p.y);
+    nearest = std::max(nearest, p.key);
+  }
+
+  int x0 = std::max(0, (int)floor(minx)) & ~3;
+  int y0 = std::max(0, (int)floor(miny));
+  int x1 = std::min(occlusion.width, (int)ceil(maxx));
+  int y1 = std::min(occlusion.height, (int)ceil(maxy));
+
+  if (x0 >= x1 || y0 >= y1)
+    return false;
+
+  for(int y = y0; y < y1; ++y)
+  {
+    float const *row = occlusion.depth.data() + y * occlusion.width;
+
+#if OCCLUSION_SSE
+
+    __m128 key = _mm_set1_ps(nearest);
+
+    for(int x = x0; x < x1; x += 4)
+    {
+      if (_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(row + x), key)) != 0)
+        return false;
+    }
+
+#else
+
+    for(int x = x0; x < x1; ++x)
+    {
+      if (row[x] < nearest)
+        return false;
+    }
+
+#endif
+  }
+
+  return true;
+}
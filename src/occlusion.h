@@ -0,0 +1,73 @@
+//
+// occlusion.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/asset.h"
+#include <vector>
+
+//|---------------------- OcclusionView -------------------------------------
+//|--------------------------------------------------------------------------
+
+struct OcclusionView
+{
+  lml::Transform invview;   // world to view, view looks down -z
+
+  bool orthographic;
+
+  float scalex, scaley;     // view to normalised device coordinates
+  float offsetx, offsety;
+
+  float znear;
+};
+
+OcclusionView occlusion_perspective(lml::Transform const &view, float fov, float aspect, float znear);
+OcclusionView occlusion_orthographic(lml::Transform const &view, float left, float bottom, float right, float top, float znear);
+
+
+//|---------------------- Occlusion -----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct Occlusion
+{
+  int width = 0;            // multiple of four
+  int height = 0;
+
+  OcclusionView view;
+
+  struct Triangle
+  {
+    int minx, miny, maxx, maxy;
+
+    float a[3], b[3], c[3];     // edge functions, inside is a*x + b*y + c >= 0
+    float zx, zy, z0;           // depth plane
+  };
+
+  std::vector<Triangle> triangles;
+
+  // depth key per pixel, larger is nearer (1/distance perspective,
+  // -distance orthographic), both linear in screen space, the farthest key
+  // of a triangle that covers the whole pixel
+
+  std::vector<float> depth;
+
+  bool active = false;
+};
+
+// appends the occluder triangles baked by pvsgen, a payload of the vertex
+// count and then xyz per vertex, carried as the texels of an rgba image
+
+void load_occluders(DatumPlatform::PlatformInterface &platform, AssetManager &assets, Asset const *asset, std::vector<lml::Vec3> &occluders);
+
+void initialise_occlusion(Occlusion &occlusion, int width, int height);
+
+// rasterises the occluder triangles into the depth buffers of count views,
+// split into row bands across the work queue when parallel, the caller
+// takes bands too and then blocks, so call it from outside the work queue
+
+void rasterise_occlusion(DatumPlatform::PlatformInterface &platform, Occlusion *occlusion, OcclusionView const *views, int count, std::vector<lml::Vec3> const &occluders, bool parallel);
+
+bool occluded(Occlusion const &occlusion, lml::Bound3 const &bound);
@@ -0,0 +1,143 @@
+//
+// particlelod.cpp
+//
+
+#include "particlelod.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace lml;
+
+namespace
+{
+  ///////////////////////// update_interval ///////////////////////////////////
+  float update_interval(float size)
+  {
+    if (size > 0.1f)
+      return 0.0f;
+
+    if (size > 0.02f)
+      return 1.0f / 30.0f;
+
+    return 1.0f / 10.0f;
+  }
+}
+
+
+///////////////////////// update_particlelod ////////////////////////////////
+void update_particlelod(ParticleLod &lod, vector<Snapshot::Particles> const &particles, Camera const &camera, float dt)
+{
+  auto frustum = camera.frustum();
+
+  float scale = 1.0f / tan(0.5f * camera.fov());
+
+  lod.candidates.clear();
+
+  lod.updates += 1;
+
+  for(size_t i = 0; i < particles.size(); ++i)
+  {
+    auto &system = lod.systems[particles[i].entity];
+
+    system.updated = lod.updates;
+    system.bound = particles[i].transform * particles[i].system->bound;
+
+    auto &bound = system.bound;
+
+    float radius = 0.5f * norm(bound.max - bound.min);
+    float distance = std::max(dist(0.5f * (bound.min + bound.max), camera.position()), radius);
+
+    system.elapsed = std::min(system.elapsed + dt, lod.fastforward);
+    system.size = scale * radius / distance;
+    system.visible = intersects(frustum, bound);
+
+    if (system.visible && system.size >= lod.minsize && system.elapsed >= update_interval(system.size))
+    {
+      lod.candidates.push_back(make_pair(system.size * system.elapsed, i));
+    }
+  }
+
+  for(auto system = lod.systems.begin(); system != lod.systems.end(); )
+  {
+    if (system->second.updated != lod.updates)
+      system = lod.systems.erase(system);
+    else
+      ++system;
+  }
+
+  // each system's share of the particle budget is in proportion to its
+  // projected size, the largest, most out of date systems are served first
+  // and a system whose share rounds to nothing waits
+
+  sort(lod.candidates.begin(), lod.candidates.end(), [](auto &a, auto &b) { return a.first > b.first; });
+
+  float totalsize = 0.0f;
+
+  for(auto &candidate : lod.candidates)
+  {
+    totalsize += lod.systems[particles[candidate.second].entity].size;
+  }
+
+  int remaining = lod.budget;
+
+  lod.simulated = 0;
+  lod.deferred = 0;
+  lod.particles = 0;
+
+  for(auto &candidate : lod.candidates)
+  {
+    auto &particle = particles[candidate.second];
+
+    auto &system = lod.systems[particle.entity];
+
+    int share = (int)(lod.budget * system.size / totalsize);
+    int limit = std::min({ particle.system->maxparticles, share, remaining });
+
+    if (limit <= 0)
+    {
+      lod.deferred += 1;
+      continue;
+    }
+
+    // particles past the share are dropped as soon as they are emitted, so
+    // emission scales down to the share
+
+    auto instance = particle.instance;
+
+    int steps = std::max((int)ceil(system.elapsed / lod.step), 1);
+
+    for(int k = 0; k < steps; ++k)
+    {
+      particle.system->update(instance, camera, particle.transform, system.elapsed / steps);
+
+      instance->count = std::min(instance->count, limit);
+    }
+
+    system.elapsed = 0.0f;
+
+    remaining -= limit;
+
+    lod.simulated += 1;
+    lod.particles += limit;
+  }
+}
+
+
+///////////////////////// update_particles //////////////////////////////////
+void update_particles(vector<Snapshot::Particles> const &particles, Camera const &camera, float dt)
+{
+  for(auto &particle : particles)
+  {
+    particle.system->update(particle.instance, camera, particle.transform, dt);
+  }
+}
+
+
+///////////////////////// particle_visible //////////////////////////////////
+bool particle_visible(ParticleLod const &lod, Scene::EntityId entity)
+{
+  auto system = lod.systems.find(entity);
+
+  return system != lod.systems.end() && system->second.visible && system->second.size >= lod.minsize;
+}
@@ -0,0 +1,64 @@
+//
+// particlelod.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/scene.h"
+#include "datum/renderer.h"
+#include "snapshot.h"
+#include <vector>
+#include <unordered_map>
+
+//|---------------------- ParticleLod ---------------------------------------
+//|--------------------------------------------------------------------------
+
+struct ParticleLod
+{
+  struct System
+  {
+    lml::Bound3 bound;      // world, from the snapshot transform
+
+    float elapsed = 0.0f;   // simulation time owed
+    float size = 0.0f;      // projected radius, fraction of the view height
+
+    bool visible = false;
+
+    size_t updated = 0;     // last update that saw the entity
+  };
+
+  std::unordered_map<Scene::EntityId, System> systems;
+
+  size_t updates = 0;
+
+  int budget = 4096;              // particles simulated per frame
+  float minsize = 0.002f;         // smaller systems are not drawn
+  float fastforward = 2.0f;       // most simulation time caught up at once
+  float step = 1.0f / 30.0f;      // fast forward step
+
+  // stats
+
+  int simulated = 0;              // systems
+  int deferred = 0;
+  int particles = 0;              // allotted to the simulated systems
+
+  // scratch
+
+  std::vector<std::pair<float, size_t>> candidates;
+};
+
+// simulates the drawn systems at a rate set by their projected size, the
+// particle budget is shared in proportion to projected size and a system
+// emits no more than its share, culled systems accrue time and are fast
+// forwarded once drawn again, entries of destroyed entities are dropped
+
+void update_particlelod(ParticleLod &lod, std::vector<Snapshot::Particles> const &particles, Camera const &camera, float dt);
+
+// steps every system at the full rate, as update_particlesystems does for
+// the scene
+
+void update_particles(std::vector<Snapshot::Particles> const &particles, Camera const &camera, float dt);
+
+bool particle_visible(ParticleLod const &lod, Scene::EntityId entity);
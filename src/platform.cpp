@@ -10,6 +10,7 @@
 #include <memory>
 #include <cstddef>
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 
@@ -122,10 +123,12 @@ namespace DatumPlatform
   {
     lock_guard<mutex> lock(m_mutex);
 
-    m_events.push_back({ Event::MouseMoveX, x });
-    m_events.push_back({ Event::MouseMoveY, y });
-    m_events.push_back({ Event::MouseDeltaX, (int)(deltax) });
-    m_events.push_back({ Event::MouseDeltaY, (int)(deltay) });
+    auto time = clock::now();
+
+    m_events.push_back({ Event::MouseMoveX, x, time });
+    m_events.push_back({ Event::MouseMoveY, y, time });
+    m_events.push_back({ Event::MouseDeltaX, (int)(deltax), time });
+    m_events.push_back({ Event::MouseDeltaY, (int)(deltay), time });
   }
 
 
@@ -134,7 +137,9 @@ namespace DatumPlatform
   {
     lock_guard<mutex> lock(m_mutex);
 
-    m_events.push_back({ Event::MousePress, button });
+    auto time = clock::now();
+
+    m_events.push_back({ Event::MousePress, button, time });
   }
 
 
@@ -143,7 +148,9 @@ namespace DatumPlatform
   {
     lock_guard<mutex> lock(m_mutex);
 
-    m_events.push_back({ Event::MouseRelease, button });
+    auto time = clock::now();
+
+    m_events.push_back({ Event::MouseRelease, button, time });
   }
 
 
@@ -152,7 +159,9 @@ namespace DatumPlatform
   {
     lock_guard<mutex> lock(m_mutex);
 
-    m_events.push_back({ Event::MouseDeltaZ, (int)(z * 120) });
+    auto time = clock::now();
+
+    m_events.push_back({ Event::MouseDeltaZ, (int)(z * 120), time });
   }
 
 
@@ -161,7 +170,9 @@ namespace DatumPlatform
   {
     lock_guard<mutex> lock(m_mutex);
 
-    m_events.push_back({ Event::KeyDown, key });
+    auto time = clock::now();
+
+    m_events.push_back({ Event::KeyDown, key, time });
   }
 
 
@@ -170,7 +181,9 @@ namespace DatumPlatform
   {
     lock_guard<mutex> lock(m_mutex);
 
-    m_events.push_back({ Event::KeyUp, key });
+    auto time = clock::now();
+
+    m_events.push_back({ Event::KeyUp, key, time });
   }
 
 
@@ -179,7 +192,9 @@ namespace DatumPlatform
   {
     lock_guard<mutex> lock(m_mutex);
 
-    m_events.push_back({ Event::Text, codepoint });
+    auto time = clock::now();
+
+    m_events.push_back({ Event::Text, codepoint, time });
   }
 
 
@@ -195,7 +210,7 @@ namespace DatumPlatform
 
 
   ///////////////////////// InputBuffer::grab /////////////////////////////////
-  GameInput InputBuffer::grab()
+  GameInput InputBuffer::grab(Stamp *stamp)
   {
     lock_guard<mutex> lock(m_mutex);
 
@@ -288,6 +303,17 @@ namespace DatumPlatform
     m_input.controllers[0].move_left = m_input.keys['A'];
     m_input.controllers[0].move_right = m_input.keys['D'];
 
+    if (stamp)
+    {
+      stamp->events = processed;
+
+      if (processed != 0)
+      {
+        stamp->oldest = m_events.front().time;
+        stamp->newest = m_events[processed - 1].time;
+      }
+    }
+
     m_events.erase(m_events.begin(), m_events.begin() + processed);
 
     return m_input;
@@ -295,6 +321,44 @@ namespace DatumPlatform
 
 
 
+  ///////////////////////// InputBuffer::peek_mouse ///////////////////////////
+  void InputBuffer::peek_mouse(float *deltax, float *deltay, bool *leftbutton) const
+  {
+    lock_guard<mutex> lock(m_mutex);
+
+    *deltax = 0;
+    *deltay = 0;
+    *leftbutton = m_input.mousebuttons[GameInput::Left].state;
+
+    for(auto &evt : m_events)
+    {
+      switch(evt.type)
+      {
+        case Event::MouseDeltaX:
+          *deltax += evt.data * (1.0f/m_width);
+          break;
+
+        case Event::MouseDeltaY:
+          *deltay += evt.data * (1.0f/m_width);
+          break;
+
+        case Event::MousePress:
+          if (evt.data == GameInput::Left)
+            *leftbutton = true;
+          break;
+
+        case Event::MouseRelease:
+          if (evt.data == GameInput::Left)
+            *leftbutton = false;
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+
   //|---------------------- WorkQueue -----------------------------------------
   //|--------------------------------------------------------------------------
 
@@ -343,6 +407,108 @@ namespace DatumPlatform
   }
 
 
+  //|---------------------- FramePacer ----------------------------------------
+  //|--------------------------------------------------------------------------
+
+  ///////////////////////// FramePacer::Constructor ///////////////////////////
+  FramePacer::FramePacer(int hz, int maxticks, int targetfps)
+  {
+    m_hz = hz;
+    m_maxticks = maxticks;
+
+    m_interval = chrono::duration_cast<clock::duration>(chrono::nanoseconds(chrono::seconds(1)) / hz);
+    m_target = chrono::duration_cast<clock::duration>(chrono::nanoseconds(chrono::seconds(1)) / targetfps);
+
+    m_tick = clock::now();
+
+    m_droppedticks = 0;
+    m_pendingticks = 0;
+
+    m_frames = 0;
+    m_lateframes = 0;
+    m_unseenticks = 0;
+
+    m_worstframe = clock::duration::zero();
+
+    m_lastframe = m_tick;
+    m_lastreport = m_tick;
+  }
+
+
+  ///////////////////////// FramePacer::ticks /////////////////////////////////
+  int FramePacer::ticks(clock::time_point time)
+  {
+    int count = 0;
+
+    while (time > m_tick && count < m_maxticks)
+    {
+      m_tick += m_interval;
+
+      ++count;
+    }
+
+    if (time > m_tick)
+    {
+      // stalled, skip the backlog instead of spiralling
+
+      auto behind = (time - m_tick) / m_interval + 1;
+
+      m_tick += behind * m_interval;
+
+      m_droppedticks += (int)behind;
+    }
+
+    m_pendingticks += count;
+
+    return count;
+  }
+
+
+  ///////////////////////// FramePacer::presented /////////////////////////////
+  void FramePacer::presented(clock::time_point time)
+  {
+    auto interval = time - m_lastframe;
+
+    if (interval > m_target + m_target / 2)
+      m_lateframes += 1;
+
+    m_worstframe = std::max(m_worstframe, interval);
+
+    int ticks = m_pendingticks.exchange(0);
+
+    if (ticks > 1)
+      m_unseenticks += ticks - 1;
+
+    m_frames += 1;
+
+    m_lastframe = time;
+  }
+
+
+  ///////////////////////// FramePacer::report ////////////////////////////////
+  bool FramePacer::report(clock::time_point time, Report &report)
+  {
+    if (time - m_lastreport < chrono::seconds(1))
+      return false;
+
+    report.frames = m_frames;
+    report.lateframes = m_lateframes;
+    report.droppedticks = m_droppedticks.exchange(0);
+    report.unseenticks = m_unseenticks;
+    report.worstframe = chrono::duration<float, milli>(m_worstframe).count();
+    report.elapsed = chrono::duration<float>(time - m_lastreport).count();
+
+    m_frames = 0;
+    m_lateframes = 0;
+    m_unseenticks = 0;
+    m_worstframe = clock::duration::zero();
+
+    m_lastreport = time;
+
+    return true;
+  }
+
+
   //|---------------------- File Handle ---------------------------------------
   //|--------------------------------------------------------------------------
 
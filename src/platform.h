@@ -17,6 +17,7 @@
 #include <condition_variable>
 #include <functional>
 #include <fstream>
+#include <chrono>
 
 namespace DatumPlatform
 {
@@ -34,6 +35,8 @@ namespace DatumPlatform
   {
     public:
 
+      typedef std::chrono::steady_clock clock;
+
       struct Event
       {
         enum Type
@@ -53,6 +56,18 @@ namespace DatumPlatform
         Type type;
 
         int64_t data;
+
+        clock::time_point time;     // registered
+      };
+
+      // registration times of the events a grab consumed
+
+      struct Stamp
+      {
+        size_t events;
+
+        clock::time_point oldest;
+        clock::time_point newest;
       };
 
     public:
@@ -74,7 +89,11 @@ namespace DatumPlatform
 
     public:
 
-      GameInput grab();
+      GameInput grab(Stamp *stamp = nullptr);
+
+      // mouse movement registered since the last grab, left in the buffer
+
+      void peek_mouse(float *deltax, float *deltay, bool *leftbutton) const;
 
     private:
 
@@ -121,6 +140,71 @@ namespace DatumPlatform
   };
 
 
+  //|---------------------- FramePacer ----------------------------------------
+  //|--------------------------------------------------------------------------
+
+  // fixed rate update schedule, catching up after a stall is capped at
+  // maxticks and the rest of the backlog is dropped rather than simulated.
+  // ticks() is called by the updating thread and presented() by the
+  // presenting one, which may differ.
+
+  class FramePacer
+  {
+    public:
+
+      typedef std::chrono::steady_clock clock;
+
+      struct Report
+      {
+        int frames;
+        int lateframes;       // frame interval over one and a half target intervals
+        int droppedticks;     // ticks skipped by the catch up cap
+        int unseenticks;      // ticks simulated but never presented
+        float worstframe;     // ms
+        float elapsed;        // s, since the previous report
+      };
+
+    public:
+      FramePacer(int hz = 60, int maxticks = 4, int targetfps = 60);
+
+      float dt() const { return 1.0f / m_hz; }
+
+      clock::time_point next_tick() const { return m_tick; }
+
+      // updates due by time, at most maxticks
+
+      int ticks(clock::time_point time);
+
+      void presented(clock::time_point time);
+
+      // counts since the previous report, once a second
+
+      bool report(clock::time_point time, Report &report);
+
+    private:
+
+      int m_hz;
+      int m_maxticks;
+
+      clock::duration m_interval;
+      clock::duration m_target;
+
+      clock::time_point m_tick;
+
+      std::atomic<int> m_droppedticks;
+      std::atomic<int> m_pendingticks;
+
+      int m_frames;
+      int m_lateframes;
+      int m_unseenticks;
+
+      clock::duration m_worstframe;
+
+      clock::time_point m_lastframe;
+      clock::time_point m_lastreport;
+  };
+
+
   //|---------------------- FileHandle ----------------------------------------
   //|--------------------------------------------------------------------------
 
@@ -0,0 +1,149 @@
+//
+// pvs.cpp
+//
+
+#include "pvs.h"
+#include "assetrequest.h"
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace lml;
+using namespace DatumPlatform;
+
+
+///////////////////////// pvs_key ///////////////////////////////////////////
+uint64_t pvs_key(Bound3 const &bound)
+{
+  // fnv-1a over the bound corners in centimetres
+
+  int32_t corners[6] = {};
+
+  for(int i = 0; i < 3; ++i)
+  {
+    corners[i] = (int32_t)floor(bound.min[i] * 100.0f + 0.5f);
+    corners[i + 3] = (int32_t)floor(bound.max[i] * 100.0f + 0.5f);
+  }
+
+  uint64_t key = 14695981039346656037ull;
+
+  for(size_t i = 0; i < sizeof(corners); ++i)
+  {
+    key = (key ^ reinterpret_cast<uint8_t const *>(corners)[i]) * 1099511628211ull;
+  }
+
+  return key;
+}
+
+
+///////////////////////// pvs_cell //////////////////////////////////////////
+int pvs_cell(PVS const &pvs, Vec3 const &position)
+{
+  auto &header = pvs.header;
+
+  if (pvs.bits.empty())
+    return -1;
+
+  int x = (int)floor((position.x - header.origin[0]) / header.cellsize[0]);
+  int y = (int)floor((position.y - header.origin[1]) / header.cellsize[1]);
+  int z = (int)floor((position.z - header.origin[2]) / header.cellsize[2]);
+
+  if (x < 0 || y < 0 || z < 0 || x >= (int)header.dimx || y >= (int)header.dimy || z >= (int)header.dimz)
+    return -1;
+
+  return (z * header.dimy + y) * header.dimx + x;
+}
+
+
+///////////////////////// pvs_visible ///////////////////////////////////////
+bool pvs_visible(PVS const &pvs, int cell, uint32_t index)
+{
+  return pvs.bits[cell * pvs.words + (index >> 5)] & (1u << (index & 31));
+}
+
+
+///////////////////////// load_pvs //////////////////////////////////////////
+void load_pvs(PlatformInterface &platform, AssetManager &assets, Asset const *pack, PVS &pvs)
+{
+  auto asset = assets.find(pack->id);
+
+  if (!asset)
+    throw runtime_error("PVS Asset Missing");
+
+  asset_guard lock(assets);
+
+  auto bits = wait_asset(platform, assets, asset);
+
+  if (!bits)
+    throw runtime_error("PVS Asset Read Failure");
+
+  auto payload = static_cast<uint32_t const *>(bits);
+
+  size_t payloadwords = (size_t)asset->width * asset->height;
+
+  const size_t headerwords = sizeof(PVS::Header) / sizeof(uint32_t);
+
+  if (payloadwords < headerwords)
+    throw runtime_error("PVS Header Error");
+
+  memcpy(&pvs.header, payload, sizeof(pvs.header));
+
+  if (pvs.header.magic != PVS::magic || pvs.header.version != PVS::version)
+    throw runtime_error("PVS Version Mismatch");
+
+  pvs.words = (pvs.header.itemcount + 31) / 32;
+
+  size_t cells = (size_t)pvs.header.dimx * pvs.header.dimy * pvs.header.dimz;
+
+  if (payloadwords < headerwords + 2 * pvs.header.itemcount + cells * pvs.words)
+    throw runtime_error("PVS Payload Error");
+
+  auto keys = payload + headerwords;
+
+  pvs.indices.clear();
+
+  for(uint32_t i = 0; i < pvs.header.itemcount; ++i)
+  {
+    pvs.indices.emplace((uint64_t)keys[2*i+1] << 32 | keys[2*i], i);
+  }
+
+  auto cellbits = keys + 2 * pvs.header.itemcount;
+
+  pvs.bits.assign(cellbits, cellbits + cells * pvs.words);
+}
+
+
+///////////////////////// apply_pvs /////////////////////////////////////////
+void apply_pvs(Visibility &visibility, PVS const &pvs, int cell)
+{
+  visibility.candidates.clear();
+  visibility.nodecandidates.clear();
+
+  if (cell < 0 || pvs.bits.empty())
+    return;
+
+  auto &items = visibility.items;
+  auto &nodes = visibility.nodes;
+
+  visibility.candidates.resize(items.size());
+
+  // running count, a node holds candidates when its subtree range does
+
+  vector<uint32_t> counts(items.size() + 1, 0);
+
+  for(size_t k = 0; k < items.size(); ++k)
+  {
+    auto index = pvs.indices.find(pvs_key(items[k].bound));
+
+    visibility.candidates[k] = (index == pvs.indices.end() || pvs_visible(pvs, cell, index->second));
+
+    counts[k + 1] = counts[k] + visibility.candidates[k];
+  }
+
+  visibility.nodecandidates.resize(nodes.size());
+
+  for(size_t i = 0; i < nodes.size(); ++i)
+  {
+    visibility.nodecandidates[i] = (counts[nodes[i].subtreeend] != counts[nodes[i].itembegin]);
+  }
+}
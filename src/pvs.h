@@ -0,0 +1,70 @@
+//
+// pvs.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/asset.h"
+#include "datum/scene.h"
+#include "visibility.h"
+#include <vector>
+#include <unordered_map>
+
+//|---------------------- PVS -----------------------------------------------
+//|--------------------------------------------------------------------------
+
+// potentially visible set, a grid of cells over the scene each holding a
+// bit per static mesh item, items are keyed by their quantised world bound
+// so the set does not depend on the scene load order
+//
+// pvsgen writes the set as the first asset of a pack, a payload of 32 bit
+// words : the header, the item keys (low word first) and the cell bitsets,
+// the packer has no raw data asset so the words are carried as the texels
+// of a single layer rgba image, the second asset holds the runtime
+// occluders (load_occluders)
+
+struct PVS
+{
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+
+    uint32_t dimx, dimy, dimz;
+    uint32_t itemcount;
+
+    float origin[3];
+    float cellsize[3];
+  };
+
+  enum { magic = 0x53565044, version = 2 };     // 'DPVS'
+
+  Header header = {};
+
+  size_t words = 0;                 // bitset words per cell
+
+  std::vector<uint32_t> bits;
+
+  std::unordered_map<uint64_t, uint32_t> indices;   // item key to bit index
+};
+
+// stable key of a static item, from its world bound
+
+uint64_t pvs_key(lml::Bound3 const &bound);
+
+// cell containing the position, -1 when outside the grid
+
+int pvs_cell(PVS const &pvs, lml::Vec3 const &position);
+
+bool pvs_visible(PVS const &pvs, int cell, uint32_t index);
+
+// reads the set from a pack baked by pvsgen
+
+void load_pvs(DatumPlatform::PlatformInterface &platform, AssetManager &assets, Asset const *pack, PVS &pvs);
+
+// restricts the visibility items to the set of the cell, items outside
+// the set stay visible, a cell of -1 lifts the restriction
+
+void apply_pvs(Visibility &visibility, PVS const &pvs, int cell);
@@ -0,0 +1,461 @@
+//
+// Datum - potentially visible set generator
+//
+
+#include "toolplatform.h"
+#include "datum/asset.h"
+#include "datum/renderer.h"
+#include "datum/scene.h"
+#include "occlusion.h"
+#include "pvs.h"
+#include "assetrequest.h"
+#include "assetpacker.h"
+#include <leap.h>
+#include <leap/pathstring.h>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+using namespace lml;
+using namespace leap;
+using namespace DatumPlatform;
+
+//|---------------------- Occluders -----------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// opaque_materials //////////////////////////////////
+vector<bool> opaque_materials(PlatformInterface &platform, const char *path)
+{
+  // per material of an mtl file in file order, alpha tested (map_d) or
+  // translucent (d < 1) materials show what is behind them
+
+  auto handle = platform.open_handle(path);
+
+  string text;
+
+  char buffer[4096];
+
+  for(size_t bytes; (bytes = platform.read_handle(handle, text.size(), buffer, sizeof(buffer))) != 0; )
+  {
+    text.append(buffer, bytes);
+
+    if (bytes < sizeof(buffer))
+      break;
+  }
+
+  platform.close_handle(handle);
+
+  vector<bool> opaque;
+
+  for(size_t begin = 0, end = 0; begin < text.size(); begin = end + 1)
+  {
+    end = text.find('\n', begin);
+
+    if (end == string::npos)
+      end = text.size();
+
+    auto line = text.substr(begin, end - begin);
+
+    line.erase(0, line.find_first_not_of(" \t"));
+
+    if (line.compare(0, 7, "newmtl ") == 0)
+      opaque.push_back(true);
+
+    if (opaque.empty())
+      continue;
+
+    if (line.compare(0, 6, "map_d ") == 0)
+      opaque.back() = false;
+
+    if (line.compare(0, 2, "d ") == 0 && atof(line.c_str() + 2) < 1.0)
+      opaque.back() = false;
+  }
+
+  return opaque;
+}
+
+
+///////////////////////// select_occluders //////////////////////////////////
+void select_occluders(PlatformInterface &platform, AssetManager &assets, Scene &scene, Model const *model, vector<bool> const &opaque, size_t budget, vector<Vec3> &occluders)
+{
+  // the largest triangles of the opaque model meshes, in world space
+
+  if (model->materials.size() != opaque.size())
+    throw runtime_error("Occluder Error: model materials do not match the mtl");
+
+  unordered_map<Material const *, size_t> materials;
+
+  for(size_t i = 0; i < model->materials.size(); ++i)
+  {
+    materials.emplace(model->materials[i], i);
+  }
+
+  struct Triangle
+  {
+    float area;
+    Vec3 a, b, c;
+  };
+
+  vector<Triangle> triangles;
+
+  for(auto &entity : scene.entities<MeshComponent>())
+  {
+    auto instance = scene.get_component<MeshComponent>(entity);
+
+    auto material = materials.find(instance.material());
+
+    if (material == materials.end() || !opaque[material->second] || !instance.mesh())
+      continue;
+
+    auto transform = scene.get_component<TransformComponent>(entity).world();
+
+    auto asset = instance.mesh()->asset;
+
+    asset_guard lock(assets);
+
+    auto bits = wait_asset(platform, assets, asset);
+
+    if (!bits)
+      throw runtime_error("Model Mesh Load Failure");
+
+    auto vertices = reinterpret_cast<PackVertex const *>(bits);
+    auto indices = reinterpret_cast<uint32_t const *>(vertices + asset->vertexcount);
+
+    for(size_t i = 0; i + 2 < asset->indexcount; i += 3)
+    {
+      auto &v0 = vertices[indices[i+0]].position;
+      auto &v1 = vertices[indices[i+1]].position;
+      auto &v2 = vertices[indices[i+2]].position;
+
+      auto a = transform * Vec3(v0[0], v0[1], v0[2]);
+      auto b = transform * Vec3(v1[0], v1[1], v1[2]);
+      auto c = transform * Vec3(v2[0], v2[1], v2[2]);
+
+      triangles.push_back({ 0.5f * norm(cross(b - a, c - a)), a, b, c });
+    }
+  }
+
+  if (triangles.size() > budget)
+  {
+    nth_element(triangles.begin(), triangles.begin() + budget, triangles.end(), [](Triangle const &lhs, Triangle const &rhs) { return lhs.area > rhs.area; });
+
+    triangles.resize(budget);
+  }
+
+  for(auto &triangle : triangles)
+  {
+    occluders.push_back(triangle.a);
+    occluders.push_back(triangle.b);
+    occluders.push_back(triangle.c);
+  }
+}
+
+
+//|---------------------- Sampling ------------------------------------------
+//|--------------------------------------------------------------------------
+
+///////////////////////// sample_visibility /////////////////////////////////
+void sample_visibility(PlatformInterface &platform, Occlusion *occlusion, vector<Vec3> const &occluders, Vec3 const &position, vector<Bound3> const &bounds, uint32_t *visible)
+{
+  // six slightly overlapping faces around the position, an item is visible
+  // when it reaches any face unoccluded
+
+  const Vec3 directions[6] = { Vec3(1, 0, 0), Vec3(-1, 0, 0), Vec3(0, 1, 0), Vec3(0, -1, 0), Vec3(0, 0, 1), Vec3(0, 0, -1) };
+  const Vec3 ups[6] = { Vec3(0, 1, 0), Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3(0, 0, 1), Vec3(0, 1, 0), Vec3(0, 1, 0) };
+
+  const float fov = 100.0f*pi<float>()/180.0f;
+  const float znear = 0.05f;
+  const float zfar = 2000.0f;
+
+  Frustum frustums[6];
+  OcclusionView views[6];
+
+  for(int face = 0; face < 6; ++face)
+  {
+    auto view = Transform::lookat(position, position + directions[face], ups[face]);
+
+    frustums[face] = view * Frustum::perspective(fov, 1.0f, znear, zfar);
+    views[face] = occlusion_perspective(view, fov, 1.0f, znear);
+  }
+
+  rasterise_occlusion(platform, occlusion, views, 6, occluders, true);
+
+  for(size_t i = 0; i < bounds.size(); ++i)
+  {
+    if (visible[i >> 5] & (1u << (i & 31)))
+      continue;
+
+    auto &bound = bounds[i];
+
+    for(int face = 0; face < 6; ++face)
+    {
+      if (intersects(frustums[face], bound) && !occluded(occlusion[face], bound))
+      {
+        visible[i >> 5] |= 1u << (i & 31);
+        break;
+      }
+    }
+  }
+}
+
+
+///////////////////////// main //////////////////////////////////////////////
+int main(int argc, char **argv)
+{
+  cout << "PVS Generator" << endl;
+
+  try
+  {
+    Vec3 cellsize = Vec3(2.0f, 2.5f, 2.0f);
+
+    for(int i = 1; i < argc; ++i)
+    {
+      if (strcmp(argv[i], "-cellsize") == 0 && i + 3 < argc)
+      {
+        cellsize.x = (float)atof(argv[++i]);
+        cellsize.y = (float)atof(argv[++i]);
+        cellsize.z = (float)atof(argv[++i]);
+      }
+      else
+        throw runtime_error("usage: pvsgen [-cellsize x y z]");
+    }
+
+    ToolPlatform platform;
+
+    initialise_platform(platform, 256*1024*1024);
+
+    AssetManager assets(platform.gamememory);
+
+    initialise_asset_system(platform, assets, 64*1024, 128*1024*1024);
+
+    ResourceManager resources(assets, platform.gamememory);
+
+    Scene scene(platform.gamememory);
+
+    scene.initialise_component_storage<TransformComponent>();
+    scene.initialise_component_storage<MeshComponent>();
+    scene.initialise_component_storage<PointLightComponent>();
+
+    auto model = assets.load(platform, "sponza.pack");
+
+    if (!model)
+      throw runtime_error("Model Assets Load Failure");
+
+    auto modelid = scene.load<Model>(platform, &resources, model);
+
+    update_meshes(scene);
+
+    // occluders are the largest opaque model triangles, only geometry that
+    // is drawn, the bake can afford a far larger set than the game rasterises
+
+    auto opaque = opaque_materials(platform, "../data/sponza.mtl");
+
+    vector<Vec3> occluders;
+
+    select_occluders(platform, assets, scene, scene.get<Model>(modelid), opaque, 16384, occluders);
+
+    vector<Vec3> runtimeoccluders;
+
+    select_occluders(platform, assets, scene, scene.get<Model>(modelid), opaque, 4096, runtimeoccluders);
+
+    cout << "  " << occluders.size() / 3 << " bake, " << runtimeoccluders.size() / 3 << " runtime occluder triangles" << endl;
+
+    Occlusion occlusion[6];
+
+    for(auto &face : occlusion)
+    {
+      initialise_occlusion(face, 128, 128);
+    }
+
+    // static mesh items, keyed by bound as the game looks them up
+
+    vector<Bound3> bounds;
+
+    Vec3 mincorner(std::numeric_limits<float>::max());
+    Vec3 maxcorner(std::numeric_limits<float>::lowest());
+
+    for(auto &entity : scene.entities<MeshComponent>())
+    {
+      bounds.push_back(scene.get_component<MeshComponent>(entity).bound());
+
+      mincorner = lml::min(mincorner, bounds.back().min);
+      maxcorner = lml::max(maxcorner, bounds.back().max);
+    }
+
+    PVS::Header header = {};
+    header.magic = PVS::magic;
+    header.version = PVS::version;
+    header.dimx = (uint32_t)ceil((maxcorner.x - mincorner.x) / cellsize.x);
+    header.dimy = (uint32_t)ceil((maxcorner.y - mincorner.y) / cellsize.y);
+    header.dimz = (uint32_t)ceil((maxcorner.z - mincorner.z) / cellsize.z);
+    header.itemcount = bounds.size();
+    header.origin[0] = mincorner.x;
+    header.origin[1] = mincorner.y;
+    header.origin[2] = mincorner.z;
+    header.cellsize[0] = cellsize.x;
+    header.cellsize[1] = cellsize.y;
+    header.cellsize[2] = cellsize.z;
+
+    size_t words = (header.itemcount + 31) / 32;
+    size_t cells = header.dimx * header.dimy * header.dimz;
+
+    cout << "Generating " << header.dimx << "x" << header.dimy << "x" << header.dimz << " cells, " << header.itemcount << " items..." << endl;
+
+    // samples on a lattice at half cell spacing, a cell takes the union of
+    // the 3x3x3 lattice points over its corners, faces and centre, shared
+    // with its neighbours
+
+    uint32_t latticex = 2 * header.dimx + 1;
+    uint32_t latticey = 2 * header.dimy + 1;
+    uint32_t latticez = 2 * header.dimz + 1;
+
+    vector<uint32_t> lattice((size_t)latticex * latticey * latticez * words, 0);
+
+    for(uint32_t z = 0; z < latticez; ++z)
+    {
+      for(uint32_t y = 0; y < latticey; ++y)
+      {
+        for(uint32_t x = 0; x < latticex; ++x)
+        {
+          auto position = mincorner + Vec3(0.5f * x * cellsize.x, 0.5f * y * cellsize.y, 0.5f * z * cellsize.z);
+
+          sample_visibility(platform, occlusion, occluders, position, bounds, lattice.data() + ((z * latticey + y) * latticex + x) * words);
+        }
+      }
+
+      cout << "  Slice " << z + 1 << "/" << latticez << endl;
+    }
+
+    vector<uint32_t> sampled(cells * words, 0);
+
+    for(uint32_t z = 0; z < header.dimz; ++z)
+    {
+      for(uint32_t y = 0; y < header.dimy; ++y)
+      {
+        for(uint32_t x = 0; x < header.dimx; ++x)
+        {
+          auto cell = sampled.data() + ((z * header.dimy + y) * header.dimx + x) * words;
+
+          for(uint32_t k = 0; k < 27; ++k)
+          {
+            auto point = lattice.data() + (((2*z + k/9) * latticey + (2*y + k/3%3)) * latticex + (2*x + k%3)) * words;
+
+            for(size_t w = 0; w < words; ++w)
+              cell[w] |= point[w];
+          }
+
+          // items reaching into the cell are always visible from it
+
+          auto lo = mincorner + Vec3(x * cellsize.x, y * cellsize.y, z * cellsize.z);
+          auto hi = lo + cellsize;
+
+          for(size_t i = 0; i < bounds.size(); ++i)
+          {
+            if (bounds[i].min.x <= hi.x && bounds[i].min.y <= hi.y && bounds[i].min.z <= hi.z && bounds[i].max.x >= lo.x && bounds[i].max.y >= lo.y && bounds[i].max.z >= lo.z)
+              cell[i >> 5] |= 1u << (i & 31);
+          }
+        }
+      }
+    }
+
+    // sampling still misses gaps narrower than the lattice, so each cell is
+    // dilated by its 26 neighbours
+
+    vector<uint32_t> bits(cells * words, 0);
+
+    size_t total = 0;
+
+    for(int z = 0; z < (int)header.dimz; ++z)
+    {
+      for(int y = 0; y < (int)header.dimy; ++y)
+      {
+        for(int x = 0; x < (int)header.dimx; ++x)
+        {
+          auto cell = bits.data() + ((z * header.dimy + y) * header.dimx + x) * words;
+
+          for(int k = 0; k < 27; ++k)
+          {
+            int nx = x + k%3 - 1;
+            int ny = y + k/3%3 - 1;
+            int nz = z + k/9 - 1;
+
+            if (nx < 0 || ny < 0 || nz < 0 || nx >= (int)header.dimx || ny >= (int)header.dimy || nz >= (int)header.dimz)
+              continue;
+
+            auto neighbour = sampled.data() + ((nz * header.dimy + ny) * header.dimx + nx) * words;
+
+            for(size_t w = 0; w < words; ++w)
+              cell[w] |= neighbour[w];
+          }
+
+          for(size_t i = 0; i < bounds.size(); ++i)
+          {
+            total += (cell[i >> 5] >> (i & 31)) & 1;
+          }
+        }
+      }
+    }
+
+    // pvs payload, header, keys then bits, carried as rgba texels
+
+    vector<uint32_t> payload;
+
+    payload.insert(payload.end(), reinterpret_cast<uint32_t const *>(&header), reinterpret_cast<uint32_t const *>(&header + 1));
+
+    for(auto &bound : bounds)
+    {
+      auto key = pvs_key(bound);
+
+      payload.push_back((uint32_t)(key & 0xFFFFFFFF));
+      payload.push_back((uint32_t)(key >> 32));
+    }
+
+    payload.insert(payload.end(), bits.begin(), bits.end());
+
+    const int width = 256;
+    const int height = (payload.size() + width - 1) / width;
+
+    payload.resize(width * height, 0);
+
+    // runtime occluders, vertex count then xyz per vertex
+
+    vector<uint32_t> occluderpayload(1, (uint32_t)runtimeoccluders.size());
+
+    for(auto &vertex : runtimeoccluders)
+    {
+      float xyz[3] = { vertex.x, vertex.y, vertex.z };
+
+      occluderpayload.resize(occluderpayload.size() + 3);
+
+      memcpy(occluderpayload.data() + occluderpayload.size() - 3, xyz, sizeof(xyz));
+    }
+
+    const int occluderheight = (occluderpayload.size() + width - 1) / width;
+
+    occluderpayload.resize(width * occluderheight, 0);
+
+    ofstream fout("sponza-pvs.pack", ios::binary | ios::trunc);
+
+    write_header(fout);
+
+    write_imag_asset(fout, 0, width, height, 1, 1, PackImageHeader::rgba, payload.data());
+
+    write_imag_asset(fout, 1, width, occluderheight, 1, 1, PackImageHeader::rgba, occluderpayload.data());
+
+    write_chunk(fout, "HEND", 0, nullptr);
+
+    fout.close();
+
+    cout << "  Average: " << total / max(cells, (size_t)1) << " of " << bounds.size() << " items per cell" << endl;
+  }
+  catch(exception &e)
+  {
+    cerr << "Critical Error:" << e.what() << endl;
+  }
+}
@@ -0,0 +1,63 @@
+//
+// resourcerequests.cpp
+//
+
+#include "resourcerequests.h"
+
+using namespace std;
+using namespace DatumPlatform;
+
+namespace
+{
+  ///////////////////////// submit_requests ///////////////////////////////////
+  template<typename Resource>
+  void submit_requests(PlatformInterface &platform, ResourceManager &resources, vector<Resource const *> const &requests, int *ready, int *total)
+  {
+    for(auto &resource : requests)
+    {
+      if (ready && total)
+        request(platform, resources, resource, ready, total);
+      else
+        resources.request(platform, resource);
+    }
+  }
+}
+
+
+///////////////////////// ResourceRequests::clear ///////////////////////////
+void ResourceRequests::clear()
+{
+  meshes.clear();
+  materials.clear();
+  seen.clear();
+
+  redundant = 0;
+}
+
+
+///////////////////////// ResourceRequests::add /////////////////////////////
+void ResourceRequests::add(Mesh const *mesh)
+{
+  if (seen.insert(mesh).second)
+    meshes.push_back(mesh);
+  else
+    redundant += 1;
+}
+
+
+///////////////////////// ResourceRequests::add /////////////////////////////
+void ResourceRequests::add(Material const *material)
+{
+  if (seen.insert(material).second)
+    materials.push_back(material);
+  else
+    redundant += 1;
+}
+
+
+///////////////////////// ResourceRequests::submit //////////////////////////
+void ResourceRequests::submit(PlatformInterface &platform, ResourceManager &resources, int *ready, int *total)
+{
+  submit_requests(platform, resources, meshes, ready, total);
+  submit_requests(platform, resources, materials, ready, total);
+}
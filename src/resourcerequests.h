@@ -0,0 +1,35 @@
+//
+// resourcerequests.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/renderer.h"
+#include <vector>
+#include <unordered_set>
+
+//|---------------------- ResourceRequests ----------------------------------
+//|--------------------------------------------------------------------------
+
+struct ResourceRequests
+{
+  std::vector<Mesh const *> meshes;
+  std::vector<Material const *> materials;
+
+  size_t redundant = 0;     // duplicate adds since the last clear
+
+  void clear();
+
+  void add(Mesh const *mesh);
+  void add(Material const *material);
+
+  // one request per unique resource, ready and total count as the datum
+  // request helper when given
+
+  void submit(DatumPlatform::PlatformInterface &platform, ResourceManager &resources, int *ready = nullptr, int *total = nullptr);
+
+  // scratch
+
+  std::unordered_set<void const *> seen;
+};
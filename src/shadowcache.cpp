@@ -0,0 +1,132 @@
+//
+// shadowcache.cpp
+//
+
+#include "shadowcache.h"
+#include <limits>
+
+using namespace std;
+using namespace lml;
+using namespace DatumPlatform;
+
+
+///////////////////////// shadow_view ///////////////////////////////////////
+Transform shadow_view(Camera const &camera, Vec3 const &sundirection, float splitfar, Bound3 &volume)
+{
+  // light view and orthographic volume (left, bottom, near to right, top, far)
+
+  const float znear = 0.1f;
+  const float zfar = splitfar;
+  const float extrusion = 1000.0f;
+
+  auto camerafrustum = camera.frustum(znear, zfar + 1.0f);
+
+  auto lightpos = camerafrustum.centre() - extrusion * sundirection;
+
+  auto lightview = Transform::lookat(lightpos, lightpos + sundirection, Vec3(0, 1, 0));
+
+  auto invlightview = inverse(lightview);
+
+  Vec3 mincorner(std::numeric_limits<float>::max());
+  Vec3 maxcorner(std::numeric_limits<float>::lowest());
+
+  for(size_t i = 1; i < 8; ++i)
+  {
+    auto corner = invlightview * camerafrustum.corners[i];
+
+    mincorner = lml::min(mincorner, corner);
+    maxcorner = lml::max(maxcorner, corner);
+  }
+
+  volume = Bound3(Vec3(mincorner.x, mincorner.y, 0.1f), Vec3(maxcorner.x, maxcorner.y, extrusion + maxcorner.z - mincorner.z));
+
+  return lightview;
+}
+
+
+///////////////////////// invalidate_shadowcache ////////////////////////////
+void invalidate_shadowcache(ShadowCache &cache)
+{
+  cache.valid = false;
+}
+
+
+///////////////////////// shadowcache_current ///////////////////////////////
+bool shadowcache_current(ShadowCache const &cache, Visibility const &visibility, Vec3 const &sundirection, Transform const &lightview, Bound3 const &volume)
+{
+  if (!cache.valid || !visibility.valid)
+    return false;
+
+  if (sundirection.x != cache.sundirection.x || sundirection.y != cache.sundirection.y || sundirection.z != cache.sundirection.z)
+    return false;
+
+  // the light views share a direction, so the volume only translates, across
+  // the light in the cached view and along it by the depth offset
+
+  auto offset = cache.invlightview * lightview.translation();
+  auto depth = dot(lightview.translation() - cache.lightview.translation(), sundirection);
+
+  if (volume.min.x + offset.x < cache.region.min.x || volume.max.x + offset.x > cache.region.max.x)
+    return false;
+
+  if (volume.min.y + offset.y < cache.region.min.y || volume.max.y + offset.y > cache.region.max.y)
+    return false;
+
+  if (volume.min.z + depth < cache.region.min.z || volume.max.z + depth > cache.region.max.z)
+    return false;
+
+  return true;
+}
+
+
+///////////////////////// gather_shadowcache ////////////////////////////////
+void gather_shadowcache(ShadowCache &cache, Visibility const &visibility, Vec3 const &sundirection, Transform const &lightview, Bound3 const &volume)
+{
+  auto grow = cache.margin * (volume.max - volume.min);
+
+  cache.valid = true;
+  cache.sundirection = sundirection;
+  cache.lightview = lightview;
+  cache.invlightview = inverse(lightview);
+  cache.region = Bound3(Vec3(volume.min.x - grow.x, volume.min.y - grow.y, volume.min.z - grow.z), volume.max + grow);
+
+  auto frustum = lightview * Frustum::orthographic(cache.region.min.x, cache.region.min.y, cache.region.max.x, cache.region.max.y, cache.region.min.z, cache.region.max.z);
+
+  cache.masks.assign(visibility.itembounds.size(), 0);
+
+  cull_bounds(cull_planes(frustum), visibility.itembounds, 0, visibility.itembounds.size(), 1, cache.masks.data());
+
+  cache.casters.clear();
+
+  for(size_t i = 0; i < cache.masks.size(); ++i)
+  {
+    if (cache.masks[i])
+      cache.casters.push_back(i);
+  }
+
+  cache.drawsort.clear();
+
+  cache.gathers += 1;
+}
+
+
+///////////////////////// finalise_shadowcache //////////////////////////////
+void finalise_shadowcache(ShadowCache &cache, Visibility const &visibility)
+{
+  cache.drawbounds.clear();
+
+  for(auto &draw : cache.drawsort.draws)
+  {
+    cache.drawbounds.push_back(visibility.items[cache.casters[draw.index]].bound);
+  }
+}
+
+
+///////////////////////// select_shadowcache ////////////////////////////////
+void select_shadowcache(ShadowCache &cache, Frustum const &frustum)
+{
+  cache.drawmasks.assign(cache.drawbounds.size(), 0);
+  cache.drawlevels.assign(cache.drawbounds.size(), 0);
+
+  cull_bounds(cull_planes(frustum), cache.drawbounds, 0, cache.drawbounds.size(), 1, cache.drawmasks.data());
+}
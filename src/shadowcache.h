@@ -0,0 +1,78 @@
+//
+// shadowcache.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/renderer.h"
+#include "visibility.h"
+#include "drawsort.h"
+#include <vector>
+
+//|---------------------- ShadowCache ---------------------------------------
+//|--------------------------------------------------------------------------
+
+struct ShadowCache
+{
+  bool valid = false;
+
+  // light direction and light space region the casters were gathered for,
+  // the region covers the shadow volume plus a margin
+
+  lml::Vec3 sundirection;
+
+  lml::Transform lightview;
+  lml::Transform invlightview;
+  lml::Bound3 region;
+
+  float margin = 0.25f;     // region growth per side, fraction of the volume extent
+
+  // static casters in the region (indices into the visibility items), their
+  // draws sorted once per gather, with the caster bounds in draw order
+
+  std::vector<uint32_t> casters;
+
+  DrawSort drawsort;
+  CullBounds drawbounds;
+
+  // per sorted draw, inside the current shadow volume and its caster lod
+  // level, set each frame
+
+  std::vector<uint32_t> drawmasks;
+  std::vector<uint8_t> drawlevels;
+
+  // stats
+
+  int gathers = 0;
+
+  // scratch
+
+  std::vector<uint32_t> masks;
+};
+
+// sun view covering the camera out to the shadow split, volume is left,
+// bottom, near to right, top, far in the light view
+
+lml::Transform shadow_view(Camera const &camera, lml::Vec3 const &sundirection, float splitfar, lml::Bound3 &volume);
+
+void invalidate_shadowcache(ShadowCache &cache);
+
+// whether the cached casters still cover the shadow volume (light space,
+// as returned by shadow_view) for the light direction
+
+bool shadowcache_current(ShadowCache const &cache, Visibility const &visibility, lml::Vec3 const &sundirection, lml::Transform const &lightview, lml::Bound3 const &volume);
+
+// gathers the static items in the grown region around the shadow volume,
+// leaves the draw sort for the caller to fill and then finalise_shadowcache
+
+void gather_shadowcache(ShadowCache &cache, Visibility const &visibility, lml::Vec3 const &sundirection, lml::Transform const &lightview, lml::Bound3 const &volume);
+
+// packs the caster bounds in sorted draw order
+
+void finalise_shadowcache(ShadowCache &cache, Visibility const &visibility);
+
+// marks the cached draws inside the current shadow frustum
+
+void select_shadowcache(ShadowCache &cache, lml::Frustum const &frustum);
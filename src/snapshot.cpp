@@ -0,0 +1,163 @@
+//
+// snapshot.cpp
+//
+
+#include "snapshot.h"
+
+using namespace std;
+using namespace lml;
+
+
+///////////////////////// begin_snapshot_write //////////////////////////////
+Snapshot &begin_snapshot_write(SnapshotBuffer &buffer)
+{
+  lock_guard<mutex> lock(buffer.lock);
+
+  int slot = -1;
+
+  for(int i = 0; i < SnapshotBuffer::Slots; ++i)
+  {
+    if (i == buffer.reading[0] || i == buffer.reading[1])
+      continue;
+
+    if (slot == -1 || buffer.snapshots[i].sequence < buffer.snapshots[slot].sequence)
+      slot = i;
+  }
+
+  buffer.snapshots[slot].sequence = 0;
+
+  buffer.writing = slot;
+
+  return buffer.snapshots[slot];
+}
+
+
+///////////////////////// end_snapshot_write ////////////////////////////////
+void end_snapshot_write(SnapshotBuffer &buffer)
+{
+  lock_guard<mutex> lock(buffer.lock);
+
+  buffer.snapshots[buffer.writing].sequence = ++buffer.published;
+
+  buffer.writing = -1;
+}
+
+
+///////////////////////// begin_snapshot_read ///////////////////////////////
+Snapshot const *begin_snapshot_read(SnapshotBuffer &buffer, Snapshot const **previous)
+{
+  lock_guard<mutex> lock(buffer.lock);
+
+  int latest = -1, before = -1;
+
+  for(int i = 0; i < SnapshotBuffer::Slots; ++i)
+  {
+    auto sequence = buffer.snapshots[i].sequence;
+
+    if (sequence == 0)
+      continue;
+
+    if (latest == -1 || sequence > buffer.snapshots[latest].sequence)
+    {
+      before = latest;
+      latest = i;
+    }
+    else if (before == -1 || sequence > buffer.snapshots[before].sequence)
+    {
+      before = i;
+    }
+  }
+
+  if (before == -1)
+    before = latest;
+
+  buffer.reading[0] = latest;
+  buffer.reading[1] = before;
+
+  if (previous)
+    *previous = (before != -1) ? &buffer.snapshots[before] : nullptr;
+
+  return (latest != -1) ? &buffer.snapshots[latest] : nullptr;
+}
+
+
+///////////////////////// end_snapshot_read /////////////////////////////////
+void end_snapshot_read(SnapshotBuffer &buffer)
+{
+  lock_guard<mutex> lock(buffer.lock);
+
+  buffer.reading[0] = -1;
+  buffer.reading[1] = -1;
+}
+
+
+///////////////////////// interpolate_snapshot //////////////////////////////
+void interpolate_snapshot(Snapshot &result, Snapshot const &previous, Snapshot const &latest, float alpha)
+{
+  result = latest;
+
+  result.time = previous.time + alpha * (latest.time - previous.time);
+
+  result.camera.set_position(previous.camera.position() + alpha * (latest.camera.position() - previous.camera.position()));
+  result.camera.set_rotation(slerp(previous.camera.rotation(), latest.camera.rotation(), alpha));
+
+  result.sundirection = normalise(previous.sundirection + alpha * (latest.sundirection - previous.sundirection));
+
+  // items and lights only blend while the set is unchanged, a spawn or
+  // destroy between the two snapshots shows the latest as is
+
+  if (previous.dynamicitems.size() == latest.dynamicitems.size())
+  {
+    for(size_t i = 0; i < result.dynamicitems.size(); ++i)
+    {
+      auto &from = previous.dynamicitems[i];
+      auto &item = result.dynamicitems[i];
+
+      if (from.entity != item.entity)
+        continue;
+
+      auto offset = (1.0f - alpha) * (from.transform.translation() - item.transform.translation());
+
+      item.transform = Transform::translation(offset) * item.transform;
+      item.bound = Bound3(item.bound.min + offset, item.bound.max + offset);
+    }
+  }
+
+  if (previous.lights.size() == latest.lights.size())
+  {
+    for(size_t i = 0; i < result.lights.size(); ++i)
+    {
+      result.lights[i].sphere.centre = previous.lights[i].sphere.centre + alpha * (latest.lights[i].sphere.centre - previous.lights[i].sphere.centre);
+    }
+  }
+}
+
+
+///////////////////////// capture_lights ////////////////////////////////////
+void capture_lights(Scene &scene, vector<Snapshot::Light> &lights)
+{
+  auto lightstorage = scene.system<PointLightComponentStorage>();
+  auto transformstorage = scene.system<TransformComponentStorage>();
+
+  for(auto &entity : lightstorage->entities())
+  {
+    auto light = lightstorage->get(entity);
+
+    lights.push_back({ Sphere(transformstorage->get(entity).world().translation(), light.range()), light.intensity(), light.attenuation() });
+  }
+}
+
+
+///////////////////////// capture_particles /////////////////////////////////
+void capture_particles(Scene &scene, vector<Snapshot::Particles> &particles)
+{
+  auto particlestorage = scene.system<ParticleSystemComponentStorage>();
+  auto transformstorage = scene.system<TransformComponentStorage>();
+
+  for(auto &entity : particlestorage->entities())
+  {
+    auto system = particlestorage->get(entity);
+
+    particles.push_back({ entity, transformstorage->get(entity).world(), system.system(), system.instance() });
+  }
+}
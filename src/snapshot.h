@@ -0,0 +1,100 @@
+//
+// snapshot.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/scene.h"
+#include "datum/renderer.h"
+#include "visibility.h"
+#include <vector>
+#include <mutex>
+
+//|---------------------- Snapshot ------------------------------------------
+//|--------------------------------------------------------------------------
+
+// the update owned state a render reads, copied out at the end of an update
+// so the next update can move the scene on while this one is rendered
+
+struct Snapshot
+{
+  struct Light
+  {
+    lml::Sphere sphere;
+    lml::Color3 intensity;
+    lml::Attenuation attenuation;
+  };
+
+  // particle instances are stepped and drawn by render alone, so only the
+  // pointers are copied, their entities outlive the snapshots
+
+  struct Particles
+  {
+    Scene::EntityId entity;
+    lml::Transform transform;
+    ParticleSystem const *system;
+    ParticleSystem::Instance *instance;
+  };
+
+  size_t sequence = 0;      // publish count, zero while being written
+
+  int mode = 0;
+  float time = 0;
+
+  Camera camera;
+
+  bool overlayinput = false;  // the update's input went to the debug overlay
+
+  lml::Vec3 sundirection;
+  lml::Color3 sunintensity;
+
+  float floorroughness = 1.0f;  // applied to the floor material by render
+
+  std::vector<Visibility::Item> dynamicitems;   // ids are assigned when culled
+  std::vector<Light> lights;
+  std::vector<Particles> particles;
+};
+
+
+//|---------------------- SnapshotBuffer ------------------------------------
+//|--------------------------------------------------------------------------
+
+// a single writer (update) and a single reader (render). The reader holds
+// the two newest complete snapshots, to interpolate between, and the writer
+// always fills the oldest of the rest, so the only sync points are the four
+// begin/end calls, each a short lock around the slot bookkeeping.
+
+struct SnapshotBuffer
+{
+  enum { Slots = 3 };
+
+  Snapshot snapshots[Slots];
+
+  size_t published = 0;
+
+  int reading[2] = { -1, -1 };    // held by the reader, newest first
+  int writing = -1;               // being filled by the writer
+
+  std::mutex lock;
+};
+
+Snapshot &begin_snapshot_write(SnapshotBuffer &buffer);
+void end_snapshot_write(SnapshotBuffer &buffer);
+
+// newest complete snapshot and the one before it (the newest again when
+// there is only one), null until the first snapshot is complete
+
+Snapshot const *begin_snapshot_read(SnapshotBuffer &buffer, Snapshot const **previous);
+void end_snapshot_read(SnapshotBuffer &buffer);
+
+// blends the positions of two snapshots, the rest is taken from latest
+
+void interpolate_snapshot(Snapshot &result, Snapshot const &previous, Snapshot const &latest, float alpha);
+
+// copies the point lights and particle systems out of the scene, the dynamic
+// meshes are copied by capture_dynamic
+
+void capture_lights(Scene &scene, std::vector<Snapshot::Light> &lights);
+void capture_particles(Scene &scene, std::vector<Snapshot::Particles> &particles);
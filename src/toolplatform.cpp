@@ -0,0 +1,95 @@
+//
+// toolplatform.cpp
+//
+
+#include "toolplatform.h"
+#include <leap.h>
+#include <leap/pathstring.h>
+#include <stdexcept>
+
+using namespace std;
+using namespace leap;
+using namespace DatumPlatform;
+
+
+///////////////////////// ToolPlatform::render_device ///////////////////////
+RenderDevice ToolPlatform::render_device()
+{
+  throw runtime_error("Not Implemented");
+}
+
+
+///////////////////////// ToolPlatform::open_handle /////////////////////////
+PlatformInterface::handle_t ToolPlatform::open_handle(const char *identifier)
+{
+  return new FileHandle(pathstring(identifier).c_str());
+}
+
+
+///////////////////////// ToolPlatform::read_handle /////////////////////////
+size_t ToolPlatform::read_handle(PlatformInterface::handle_t handle, uint64_t position, void *buffer, size_t bytes)
+{
+  return static_cast<FileHandle*>(handle)->read(position, buffer, bytes);
+}
+
+
+///////////////////////// ToolPlatform::close_handle ////////////////////////
+void ToolPlatform::close_handle(PlatformInterface::handle_t handle)
+{
+  delete static_cast<FileHandle*>(handle);
+}
+
+
+///////////////////////// ToolPlatform::show_cursor /////////////////////////
+void ToolPlatform::show_cursor(bool show)
+{
+  throw runtime_error("Not Implemented");
+}
+
+
+///////////////////////// ToolPlatform::create_cursor ///////////////////////
+PlatformInterface::cursor_t ToolPlatform::create_cursor(int hx, int hy, int width, int height, void const *bits)
+{
+  throw runtime_error("Not Implemented");
+}
+
+
+///////////////////////// ToolPlatform::set_cursor_image ////////////////////
+void ToolPlatform::set_cursor_image(cursor_t handle)
+{
+  throw runtime_error("Not Implemented");
+}
+
+
+///////////////////////// ToolPlatform::destroy_cursor //////////////////////
+void ToolPlatform::destroy_cursor(cursor_t handle)
+{
+  throw runtime_error("Not Implemented");
+}
+
+
+///////////////////////// ToolPlatform::set_cursor_position /////////////////
+void ToolPlatform::set_cursor_position(float x, float y)
+{
+  throw runtime_error("Not Implemented");
+}
+
+
+///////////////////////// ToolPlatform::submit_work /////////////////////////
+void ToolPlatform::submit_work(void (*func)(PlatformInterface &, void*, void*), void *ldata, void *rdata)
+{
+  m_workqueue.push([=]() { func(*this, ldata, rdata); });
+}
+
+
+///////////////////////// ToolPlatform::terminate ///////////////////////////
+void ToolPlatform::terminate()
+{
+}
+
+
+///////////////////////// initialise_platform ///////////////////////////////
+void initialise_platform(ToolPlatform &platform, size_t gamememorysize)
+{
+  gamememory_initialise(platform.gamememory, new char[gamememorysize], gamememorysize);
+}
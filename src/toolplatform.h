@@ -0,0 +1,42 @@
+//
+// toolplatform.h
+//
+
+#pragma once
+
+#include "platform.h"
+
+//|---------------------- ToolPlatform --------------------------------------
+//|--------------------------------------------------------------------------
+
+// file and work queue services for the offline tools, no render device or
+// cursor
+
+class ToolPlatform : public DatumPlatform::PlatformInterface
+{
+  public:
+
+    DatumPlatform::RenderDevice render_device() override;
+
+    handle_t open_handle(const char *identifier) override;
+    size_t read_handle(handle_t handle, uint64_t position, void *buffer, size_t bytes) override;
+    void close_handle(handle_t handle) override;
+
+    void show_cursor(bool show) override;
+    cursor_t create_cursor(int hx, int hy, int width, int height, void const *bits) override;
+    void set_cursor_image(cursor_t cursor) override;
+    void destroy_cursor(cursor_t cursor) override;
+    void set_cursor_position(float x, float y) override;
+
+    void submit_work(void (*func)(DatumPlatform::PlatformInterface &, void*, void*), void *ldata, void *rdata) override;
+
+    void terminate() override;
+
+  protected:
+
+    DatumPlatform::WorkQueue m_workqueue;
+
+    friend void initialise_platform(ToolPlatform &platform, size_t gamememorysize);
+};
+
+void initialise_platform(ToolPlatform &platform, size_t gamememorysize);
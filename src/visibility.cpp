@@ -0,0 +1,566 @@
+//
+// visibility.cpp
+//
+
+#include "visibility.h"
+#include <algorithm>
+
+using namespace std;
+using namespace lml;
+
+namespace
+{
+  ///////////////////////// resource_id ///////////////////////////////////////
+  uint32_t resource_id(Visibility &visibility, void const *resource)
+  {
+    return visibility.resourceids.emplace(resource, visibility.resourceids.size()).first->second;
+  }
+
+  ///////////////////////// make_item /////////////////////////////////////////
+  Visibility::Item make_item(Visibility &visibility, MeshComponentStorage *meshstorage, TransformComponentStorage *transformstorage, Scene::EntityId entity)
+  {
+    auto instance = meshstorage->get(entity);
+    auto transform = transformstorage->get(entity);
+
+    return { entity, instance.bound(), transform.world(), instance.mesh(), instance.material(), resource_id(visibility, instance.mesh()), resource_id(visibility, instance.material()) };
+  }
+
+  ///////////////////////// build_tree ////////////////////////////////////////
+  void build_tree(Visibility &visibility, Scene &scene)
+  {
+    auto meshstorage = scene.system<MeshComponentStorage>();
+    auto transformstorage = scene.system<TransformComponentStorage>();
+
+    visibility.nodes.clear();
+    visibility.items.clear();
+    visibility.itembounds.clear();
+
+    struct Pending
+    {
+      decltype(meshstorage->tree().begin()) end;
+      size_t node;
+    };
+
+    vector<Pending> stack;
+
+    for(auto branch = meshstorage->tree().begin(), end = meshstorage->tree().end(); branch != end; ++branch)
+    {
+      while (!stack.empty() && !(stack.back().end != branch))
+      {
+        visibility.nodes[stack.back().node].skip = visibility.nodes.size();
+        visibility.nodes[stack.back().node].subtreeend = visibility.items.size();
+
+        stack.pop_back();
+      }
+
+      stack.push_back({ next(branch), visibility.nodes.size() });
+
+      Visibility::Node node;
+      node.bound = branch.bound();
+      node.itembegin = visibility.items.size();
+
+      for(auto &entity : branch.items())
+      {
+        visibility.items.push_back(make_item(visibility, meshstorage, transformstorage, entity));
+        visibility.itembounds.push_back(visibility.items.back().bound);
+      }
+
+      node.itemend = visibility.items.size();
+
+      visibility.nodes.push_back(node);
+
+      branch.descend();
+    }
+
+    while (!stack.empty())
+    {
+      visibility.nodes[stack.back().node].skip = visibility.nodes.size();
+      visibility.nodes[stack.back().node].subtreeend = visibility.items.size();
+
+      stack.pop_back();
+    }
+
+    visibility.origin = visibility.nodes.empty() ? Vec3(0.0f) : 0.5f * (visibility.nodes[0].bound.min + visibility.nodes[0].bound.max);
+
+    for(auto &node : visibility.nodes)
+    {
+      node.reach = dist(0.5f * (node.bound.min + node.bound.max), visibility.origin) + 0.5f * norm(node.bound.max - node.bound.min);
+    }
+
+    visibility.rejectplanes.assign(visibility.nodes.size() * Visibility::MaxViews, 0);
+
+    visibility.coherence.assign(visibility.nodes.size() * Visibility::MaxViews, { 0, Visibility::Partial, -1.0f });
+
+    visibility.itemviews.assign(visibility.items.size(), 0);
+
+    for(auto &reference : visibility.references)
+    {
+      reference.valid = false;
+    }
+
+    visibility.valid = true;
+  }
+
+  ///////////////////////// test_node /////////////////////////////////////////
+  bool test_node(CullPlanes const &planes, Vec3 const &centre, Vec3 const &extent, uint32_t &planemask, uint8_t &rejectplane, float &margin, size_t &planetests)
+  {
+    // tests the node against the planes still in the mask, starting with the
+    // plane that last rejected it, and drops planes the node is fully inside.
+    // margin is how far outside the rejecting plane, or the least distance
+    // inside the dropped planes
+
+    for(int i = -1; i < planes.count; ++i)
+    {
+      int k = (i < 0) ? rejectplane : i;
+
+      if (!(planemask & (1 << k)) || (i >= 0 && k == rejectplane))
+        continue;
+
+      float d = planes.nx[k] * centre.x + planes.ny[k] * centre.y + planes.nz[k] * centre.z + planes.d[k];
+      float r = planes.ax[k] * extent.x + planes.ay[k] * extent.y + planes.az[k] * extent.z;
+
+      planetests += 1;
+
+      if (d + r < 0.0f)
+      {
+        rejectplane = k;
+
+        margin = -(d + r);
+
+        return false;
+      }
+
+      if (d - r >= 0.0f)
+      {
+        planemask &= ~(1 << k);
+
+        margin = std::min(margin, d - r);
+      }
+    }
+
+    return true;
+  }
+
+  ///////////////////////// plane_motion //////////////////////////////////////
+  bool plane_motion(CullPlanes const &reference, CullPlanes const &planes, Vec3 const &origin, float &deltan, float &deltad)
+  {
+    // bounds the change of any plane value as deltan * |p - origin| + deltad
+
+    if (reference.count != planes.count)
+      return false;
+
+    deltan = 0.0f;
+    deltad = 0.0f;
+
+    for(int k = 0; k < planes.count; ++k)
+    {
+      Vec3 n0(reference.nx[k], reference.ny[k], reference.nz[k]);
+      Vec3 n1(planes.nx[k], planes.ny[k], planes.nz[k]);
+
+      if (dot(n0, n1) < 0.5f)
+        return false;
+
+      deltan = std::max(deltan, norm(n1 - n0));
+      deltad = std::max(deltad, std::abs((dot(n1, origin) + planes.d[k]) - (dot(n0, origin) + reference.d[k])));
+    }
+
+    return true;
+  }
+
+  ///////////////////////// occlude ///////////////////////////////////////////
+  uint32_t occlude(Occlusion const *occlusion, int count, Bound3 const &bound, uint32_t views)
+  {
+    // removes the views whose depth buffer hides the bound
+
+    for(int view = 0; view < count; ++view)
+    {
+      if ((views & (1 << view)) && occluded(occlusion[view], bound))
+        views &= ~(1 << view);
+    }
+
+    return views;
+  }
+
+  ///////////////////////// candidate /////////////////////////////////////////
+  uint32_t candidate(Visibility &visibility, size_t item, uint32_t views)
+  {
+    // removes the restricted views from items outside the set, counting them
+
+    if (visibility.candidates[item] || !(views & visibility.candidateviews))
+      return views;
+
+    visibility.noncandidates += 1;
+
+    return visibility.cullcandidates ? views & ~visibility.candidateviews : views;
+  }
+}
+
+
+///////////////////////// invalidate_visibility /////////////////////////////
+void invalidate_visibility(Visibility &visibility)
+{
+  visibility.valid = false;
+}
+
+
+///////////////////////// prepare_visibility ////////////////////////////////
+void prepare_visibility(Visibility &visibility, Scene &scene)
+{
+  if (!visibility.valid)
+  {
+    build_tree(visibility, scene);
+  }
+
+  if (!visibility.captureddynamics)
+  {
+    visibility.dynamicitems.clear();
+
+    capture_dynamic(scene, visibility.dynamicitems);
+  }
+}
+
+
+///////////////////////// cull_visibility ///////////////////////////////////
+void cull_visibility(Visibility &visibility, Frustum const *frustums, Occlusion const *occlusion, int count)
+{
+  assert(count <= Visibility::MaxViews);
+  assert(visibility.valid);
+
+  visibility.visible.clear();
+
+  visibility.planetests = 0;
+  visibility.coherentnodes = 0;
+  visibility.occludednodes = 0;
+  visibility.occludeditems = 0;
+  visibility.noncandidates = 0;
+
+  for(int view = 0; view < count; ++view)
+  {
+    visibility.viewstats[view] = {};
+  }
+
+  CullPlanes planes[Visibility::MaxViews];
+
+  for(int view = 0; view < count; ++view)
+  {
+    planes[view] = cull_planes(frustums[view]);
+  }
+
+  float deltan[Visibility::MaxViews];
+  float deltad[Visibility::MaxViews];
+
+  for(int view = 0; view < count; ++view)
+  {
+    auto &reference = visibility.references[view];
+
+    bool coherent = false;
+
+    if (reference.valid && visibility.coherencethreshold > 0.0f && !visibility.nodes.empty())
+    {
+      if (plane_motion(reference.planes, planes[view], visibility.origin, deltan[view], deltad[view]))
+      {
+        coherent = (deltan[view] * visibility.nodes[0].reach + deltad[view] <= visibility.coherencethreshold);
+
+        // allow for rounding in the stored margins
+
+        deltad[view] += 1e-3f;
+      }
+    }
+
+    if (!coherent)
+    {
+      reference.valid = true;
+      reference.epoch += 1;
+      reference.planes = planes[view];
+
+      deltan[view] = 0.0f;
+      deltad[view] = 0.0f;
+    }
+  }
+
+  const uint32_t allviews = (1 << count) - 1;
+
+  //
+  // Static Tree
+  //
+
+  struct Level
+  {
+    uint32_t skip;
+    uint32_t inside;        // views fully containing the node
+    uint32_t partial;       // views intersecting the node
+    uint32_t cached;        // partial views with coherent item results
+
+    uint8_t planemasks[Visibility::MaxViews];    // planes still to test, per view
+    float margins[Visibility::MaxViews];         // least distance inside the dropped planes
+  };
+
+  Level stack[64];
+  size_t depth = 0;
+
+  auto &nodes = visibility.nodes;
+  auto &items = visibility.items;
+  auto &masks = visibility.masks;
+
+  masks.resize(items.size());
+
+  bool filtered = !visibility.candidates.empty() && visibility.candidates.size() == items.size() && visibility.nodecandidates.size() == nodes.size();
+
+  Level root = { 0, 0, allviews & visibility.treeviews, 0, {}, {} };
+
+  for(int view = 0; view < count; ++view)
+  {
+    root.planemasks[view] = (1 << planes[view].count) - 1;
+    root.margins[view] = std::numeric_limits<float>::max();
+  }
+
+  for(size_t i = 0; i < nodes.size(); )
+  {
+    while (depth != 0 && stack[depth-1].skip == i)
+      --depth;
+
+    auto &node = nodes[i];
+    auto &parent = (depth != 0) ? stack[depth-1] : root;
+
+    // restricted views drop subtrees without candidates
+
+    uint32_t excluded = (filtered && visibility.cullcandidates && !visibility.nodecandidates[i]) ? visibility.candidateviews : 0;
+
+    if (((parent.inside | parent.partial) & ~excluded) == 0)
+    {
+      i = node.skip;
+      continue;
+    }
+
+    auto centre = 0.5f * (node.bound.min + node.bound.max);
+    auto extent = 0.5f * (node.bound.max - node.bound.min);
+
+    Level level = { node.skip, parent.inside & ~excluded, 0, 0, {}, {} };
+
+    for(int view = 0; view < count; ++view)
+    {
+      if (!(parent.partial & ~excluded & (1 << view)))
+        continue;
+
+      auto &reference = visibility.references[view];
+      auto &coherence = visibility.coherence[i * Visibility::MaxViews + view];
+
+      float slack = deltan[view] * node.reach + deltad[view];
+
+      if (coherence.epoch == reference.epoch && coherence.margin > slack)
+      {
+        if (coherence.state == Visibility::Inside)
+          level.inside |= 1 << view;
+
+        if (coherence.state == Visibility::Partial)
+        {
+          // item results still hold, children test for themselves
+
+          level.partial |= 1 << view;
+          level.planemasks[view] = parent.planemasks[view];
+          level.margins[view] = parent.margins[view];
+          level.cached |= 1 << view;
+        }
+
+        visibility.coherentnodes += 1;
+
+        continue;
+      }
+
+      uint32_t planemask = parent.planemasks[view];
+
+      float margin = parent.margins[view];
+
+      if (test_node(planes[view], centre, extent, planemask, visibility.rejectplanes[i * Visibility::MaxViews + view], margin, visibility.planetests))
+      {
+        if (planemask == 0)
+        {
+          level.inside |= 1 << view;
+
+          coherence = { reference.epoch, Visibility::Inside, margin - slack };
+        }
+        else
+        {
+          level.partial |= 1 << view;
+          level.planemasks[view] = planemask;
+          level.margins[view] = margin;
+
+          coherence = { reference.epoch, Visibility::Partial, -1.0f };
+        }
+      }
+      else
+      {
+        coherence = { reference.epoch, Visibility::Outside, margin - slack };
+      }
+    }
+
+    if (occlusion && (level.inside | level.partial) != 0)
+    {
+      uint32_t views = occlude(occlusion, count, node.bound, level.inside | level.partial);
+
+      if (views != (level.inside | level.partial))
+        visibility.occludednodes += 1;
+
+      level.inside &= views;
+      level.partial &= views;
+      level.cached &= views;
+    }
+
+    for(int view = 0; view < count; ++view)
+    {
+      if (parent.partial & (1 << view))
+      {
+        auto &stats = visibility.viewstats[view];
+
+        stats.nodesvisited += 1;
+
+        if (level.inside & (1 << view))
+          stats.nodesinside += 1;
+
+        else if (!(level.partial & (1 << view)))
+          stats.nodesrejected += 1;
+      }
+    }
+
+    if (level.inside == 0 && level.partial == 0)
+    {
+      i = node.skip;
+      continue;
+    }
+
+    if (level.partial == 0)
+    {
+      for(size_t k = node.itembegin; k != node.subtreeend; ++k)
+      {
+        uint32_t views = occlusion ? occlude(occlusion, count, items[k].bound, level.inside) : level.inside;
+
+        if (views == 0)
+          visibility.occludeditems += 1;
+
+        if (views != 0 && filtered)
+          views = candidate(visibility, k, views);
+
+        if (views != 0)
+        {
+          visibility.visible.push_back({ &items[k], views });
+        }
+      }
+
+      i = node.skip;
+      continue;
+    }
+
+    std::fill(masks.begin() + node.itembegin, masks.begin() + node.itemend, level.inside);
+
+    for(int view = 0; view < count; ++view)
+    {
+      if (level.cached & (1 << view))
+      {
+        for(size_t k = node.itembegin; k != node.itemend; ++k)
+        {
+          masks[k] |= visibility.itemviews[k] & (1 << view);
+        }
+      }
+
+      else if (level.partial & (1 << view))
+      {
+        auto subset = cull_planes(planes[view], level.planemasks[view]);
+
+        float margin = cull_bounds(subset, visibility.itembounds, node.itembegin, node.itemend - node.itembegin, 1 << view, masks.data());
+
+        for(size_t k = node.itembegin; k != node.itemend; ++k)
+        {
+          visibility.itemviews[k] = (visibility.itemviews[k] & ~(1 << view)) | (masks[k] & (1 << view));
+        }
+
+        auto &coherence = visibility.coherence[i * Visibility::MaxViews + view];
+
+        coherence.margin = std::min(margin, level.margins[view]) - (deltan[view] * node.reach + deltad[view]);
+
+        visibility.planetests += subset.count * (node.itemend - node.itembegin);
+        visibility.viewstats[view].itemstested += node.itemend - node.itembegin;
+      }
+    }
+
+    for(size_t k = node.itembegin; k != node.itemend; ++k)
+    {
+      if (masks[k] != 0 && occlusion)
+      {
+        masks[k] = occlude(occlusion, count, items[k].bound, masks[k]);
+
+        if (masks[k] == 0)
+          visibility.occludeditems += 1;
+      }
+
+      if (masks[k] != 0 && filtered)
+        masks[k] = candidate(visibility, k, masks[k]);
+
+      if (masks[k] != 0)
+      {
+        visibility.visible.push_back({ &items[k], masks[k] });
+      }
+    }
+
+    assert(depth < extentof(stack));
+
+    stack[depth++] = level;
+
+    ++i;
+  }
+
+  //
+  // Dynamic
+  //
+
+  visibility.dynamicbounds.clear();
+
+  for(auto &item : visibility.dynamicitems)
+  {
+    item.meshid = resource_id(visibility, item.mesh);
+    item.materialid = resource_id(visibility, item.material);
+
+    visibility.dynamicbounds.push_back(item.bound);
+  }
+
+  masks.assign(visibility.dynamicitems.size(), 0);
+
+  for(int view = 0; view < count; ++view)
+  {
+    cull_bounds(planes[view], visibility.dynamicbounds, 0, visibility.dynamicitems.size(), 1 << view, masks.data());
+
+    visibility.planetests += planes[view].count * visibility.dynamicitems.size();
+    visibility.viewstats[view].itemstested += visibility.dynamicitems.size();
+  }
+
+  for(size_t k = 0; k < visibility.dynamicitems.size(); ++k)
+  {
+    if (masks[k] != 0 && occlusion)
+    {
+      masks[k] = occlude(occlusion, count, visibility.dynamicitems[k].bound, masks[k]);
+
+      if (masks[k] == 0)
+        visibility.occludeditems += 1;
+    }
+
+    if (masks[k] != 0)
+    {
+      visibility.visible.push_back({ &visibility.dynamicitems[k], masks[k] });
+    }
+  }
+}
+
+
+///////////////////////// capture_dynamic ///////////////////////////////////
+void capture_dynamic(Scene &scene, vector<Visibility::Item> &items)
+{
+  auto meshstorage = scene.system<MeshComponentStorage>();
+  auto transformstorage = scene.system<TransformComponentStorage>();
+
+  for(auto &entity : meshstorage->dynamic())
+  {
+    auto instance = meshstorage->get(entity);
+    auto transform = transformstorage->get(entity);
+
+    items.push_back({ entity, instance.bound(), transform.world(), instance.mesh(), instance.material(), 0, 0 });
+  }
+}
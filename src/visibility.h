@@ -0,0 +1,160 @@
+//
+// visibility.h
+//
+
+#pragma once
+
+#include "datum.h"
+#include "datum/math.h"
+#include "datum/scene.h"
+#include "datum/renderer.h"
+#include "cullkernel.h"
+#include "occlusion.h"
+#include <vector>
+#include <unordered_map>
+
+//|---------------------- Visibility ----------------------------------------
+//|--------------------------------------------------------------------------
+
+struct Visibility
+{
+  enum { MaxViews = 8 };
+
+  struct Node
+  {
+    lml::Bound3 bound;
+
+    uint32_t skip;          // first node past this subtree
+    uint32_t itembegin;     // items owned by this node
+    uint32_t itemend;
+    uint32_t subtreeend;    // items owned by this subtree
+
+    float reach;            // furthest extent of the node from the tree origin
+  };
+
+  struct Item
+  {
+    Scene::EntityId entity;
+
+    lml::Bound3 bound;
+    lml::Transform transform;
+
+    Mesh const *mesh;
+    Material const *material;
+
+    uint32_t meshid;        // dense ids, for draw sorting
+    uint32_t materialid;
+  };
+
+  struct Visible
+  {
+    Item const *item;
+
+    uint32_t views;         // bit per view the item is visible in
+  };
+
+  bool valid = false;
+
+  // flattened copy of the static mesh tree (pre-order)
+
+  std::vector<Node> nodes;
+  std::vector<Item> items;
+  CullBounds itembounds;
+
+  std::unordered_map<void const *, uint32_t> resourceids;
+
+  // dynamic meshes, refreshed each frame by prepare_visibility, or filled
+  // by the caller (see capture_dynamic) when captureddynamics is set
+
+  bool captureddynamics = false;
+
+  std::vector<Item> dynamicitems;
+  CullBounds dynamicbounds;
+
+  // last rejecting plane, per node and view
+
+  std::vector<uint8_t> rejectplanes;
+
+  // temporal coherence, nodes classified against a per view reference
+  // frustum are reused until the frustum has moved further than their margin
+
+  enum { Outside, Partial, Inside };
+
+  struct Coherence
+  {
+    uint32_t epoch;
+    uint8_t state;
+    float margin;
+  };
+
+  struct Reference
+  {
+    bool valid;
+    uint32_t epoch;
+    CullPlanes planes;
+  };
+
+  lml::Vec3 origin;
+
+  Reference references[MaxViews] = {};
+
+  std::vector<Coherence> coherence;
+  std::vector<uint32_t> itemviews;
+
+  float coherencethreshold = 0.5f;  // reference refresh distance, zero disables
+
+  // optional candidate set (potentially visible set), per static item and
+  // per node subtree, empty for none, restricts the candidate views when
+  // cullcandidates is set and otherwise only counts
+
+  std::vector<uint8_t> candidates;
+  std::vector<uint8_t> nodecandidates;
+
+  uint32_t candidateviews = 1;
+  bool cullcandidates = true;
+
+  // views culled against the static tree, the others only see dynamic items
+  // (eg. a view whose static items are cached elsewhere)
+
+  uint32_t treeviews = ~0u;
+
+  // scratch
+
+  std::vector<uint32_t> masks;
+
+  // cull result
+
+  std::vector<Visible> visible;
+
+  size_t planetests = 0;
+  size_t coherentnodes = 0;
+  size_t occludednodes = 0;
+  size_t occludeditems = 0;
+  size_t noncandidates = 0;        // static items in a candidate view but outside the set
+
+  struct ViewStats
+  {
+    size_t nodesvisited;    // nodes classified against the view
+    size_t nodesinside;     // of those, fully contained
+    size_t nodesrejected;   // of those, outside or occluded
+    size_t itemstested;     // items tested individually
+  };
+
+  ViewStats viewstats[MaxViews] = {};
+};
+
+void invalidate_visibility(Visibility &visibility);
+
+// builds the static tree from the scene when invalid and, unless they are
+// captured, copies the dynamic meshes, the cull itself reads no scene state
+
+void prepare_visibility(Visibility &visibility, Scene &scene);
+
+// views are expected to keep their index from frame to frame, occlusion is
+// optional and holds a depth buffer per view
+
+void cull_visibility(Visibility &visibility, lml::Frustum const *frustums, Occlusion const *occlusion, int count);
+
+// copies the dynamic meshes out of the scene, ids are assigned when culled
+
+void capture_dynamic(Scene &scene, std::vector<Visibility::Item> &items);